@@ -0,0 +1,947 @@
+/*
+    headless benchmarks of the wrapper hot paths, one JSON object per line on stdout:
+
+        {"benchmark":"surface_fill/ARGB8888/256","iterations":51200,"ns_per_iter":1953.1,"items_per_second":33554432.0}
+
+    items are pixels for the surface / texture paths, draw calls or glyphs elsewhere.
+    it runs on the dummy video and audio drivers with the software renderer, so the numbers are CPU only.
+    the file based benchmarks only run when their asset is given:
+
+        benchmarks [--font a.ttf] [--image a.png] [--wav a.wav] [--ogg a.ogg] [--min-time seconds]
+*/
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <unordered_map>
+#include "sdl2_wrapper.hpp"
+
+#undef main
+
+constexpr int WINDOW_WIDTH = 1024;
+constexpr int WINDOW_HEIGHT = 1024;
+
+constexpr int DEFAULT_FREQUENCY = 48000;
+constexpr int DEFAULT_CHANNEL_NUM = 2;
+constexpr int DEFAULT_CHUNK_SIZE = 2048;
+
+struct Options {
+    std::string font;
+    std::string image;
+    std::string wav;
+    std::string ogg;
+    double minSeconds = 0.25;
+};
+
+double g_minSeconds = 0.25;
+
+/*
+    runs f until minSeconds passed, doubling the iteration count each round,
+    then prints the time of the last round.
+*/
+void bench(const std::string& name, double itemsPerIter, const std::function<void()>& f) {
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t iterations = 1;
+    uint64_t ticks = 0;
+
+    // warm up the caches and the lazily built blit maps.
+    f();
+
+    while (true) {
+        uint64_t begin = SDL_GetPerformanceCounter();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            f();
+        }
+
+        ticks = SDL_GetPerformanceCounter() - begin;
+        if (static_cast<double>(ticks) / frequency >= g_minSeconds) {
+            break;
+        }
+
+        iterations *= 2;
+    }
+
+    double seconds = static_cast<double>(ticks) / frequency;
+    char line[512];
+    snprintf(line, sizeof(line), "{\"benchmark\":\"%s\",\"iterations\":%llu,\"ns_per_iter\":%.1f,\"items_per_second\":%.1f}",
+             name.c_str(), static_cast<unsigned long long>(iterations), seconds * 1e9 / iterations, itemsPerIter * iterations / seconds);
+    std::cout << line << std::endl;
+}
+
+void skip(const std::string& name, const std::string& reason) {
+    std::cout << "{\"benchmark\":\"" << name << "\",\"skipped\":\"" << reason << "\"}" << std::endl;
+}
+
+struct Format {
+    const char* name;
+    uint32_t format;
+};
+
+const Format FORMATS[] = {
+    { "ARGB8888", SDL_PIXELFORMAT_ARGB8888 },
+    { "XRGB8888", SDL_PIXELFORMAT_XRGB8888 },
+    { "ABGR8888", SDL_PIXELFORMAT_ABGR8888 },
+    { "RGB24", SDL_PIXELFORMAT_RGB24 },
+    { "RGB565", SDL_PIXELFORMAT_RGB565 },
+};
+
+const int SIZES[] = { 64, 256, 1024 };
+
+sdl2::Surface make_surface(int w, int h, uint32_t format, uint8_t alpha) {
+    sdl2::Surface surface{ SDL_CreateRGBSurfaceWithFormat(0, w, h, SDL_BITSPERPIXEL(format), format) };
+    if (surface.get() == nullptr) {
+        const char* sdlErrMsg = SDL_GetError();
+        throw sdl2::SDL2Exception{ "SDL_CreateRGBSurfaceWithFormat() failed", sdlErrMsg };
+    }
+
+    // a gradient, so RLE and the blitters can't take shortcuts.
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            SDL_Rect pixel = { x, y, 1, 1 };
+            uint32_t color = SDL_MapRGBA(surface->format, static_cast<uint8_t>(x), static_cast<uint8_t>(y), static_cast<uint8_t>(x ^ y), alpha);
+            SDL_FillRect(surface.get(), &pixel, color);
+        }
+    }
+
+    return surface;
+}
+
+std::string name_of(const char* group, const char* format, int size) {
+    return std::string{ group } + "/" + format + "/" + std::to_string(size);
+}
+
+void bench_surfaces(SDL_Surface* windowSurface) {
+    for (const auto& format : FORMATS) {
+        for (int size : SIZES) {
+            sdl2::Surface surface = make_surface(size, size, format.format, 255);
+            SDL_Rect rect = { 0, 0, size, size };
+            double pixels = static_cast<double>(size) * size;
+
+            bench(name_of("surface_fill", format.name, size), pixels, [&] {
+                sdl2::sdl_fill_rect(surface.get(), &rect, 0x80402010);
+            });
+        }
+    }
+
+    // blits into the window surface, the format conversion path of draw_img() and draw_bmp().
+    for (const auto& format : FORMATS) {
+        for (int size : SIZES) {
+            sdl2::Surface opaque = make_surface(size, size, format.format, 255);
+            SDL_SetSurfaceBlendMode(opaque.get(), SDL_BLENDMODE_NONE);
+            double pixels = static_cast<double>(size) * size;
+
+            bench(name_of("blit_copy", format.name, size), pixels, [&] {
+                SDL_Rect dstRect = { 0, 0, size, size };
+                sdl2::sdl_blit_surface(opaque.get(), nullptr, windowSurface, &dstRect);
+            });
+        }
+    }
+
+    for (int size : SIZES) {
+        sdl2::Surface translucent = make_surface(size, size, SDL_PIXELFORMAT_ARGB8888, 128);
+        SDL_SetSurfaceBlendMode(translucent.get(), SDL_BLENDMODE_BLEND);
+        double pixels = static_cast<double>(size) * size;
+
+        bench(name_of("blit_blend", "ARGB8888", size), pixels, [&] {
+            SDL_Rect dstRect = { 0, 0, size, size };
+            sdl2::sdl_blit_surface(translucent.get(), nullptr, windowSurface, &dstRect);
+        });
+
+        sdl2::Surface keyed = make_surface(size, size, SDL_PIXELFORMAT_ARGB8888, 255);
+        SDL_SetSurfaceBlendMode(keyed.get(), SDL_BLENDMODE_NONE);
+        SDL_SetColorKey(keyed.get(), SDL_TRUE, 0xff000000);
+
+        bench(name_of("blit_colorkey", "ARGB8888", size), pixels, [&] {
+            SDL_Rect dstRect = { 0, 0, size, size };
+            sdl2::sdl_blit_surface(keyed.get(), nullptr, windowSurface, &dstRect);
+        });
+    }
+}
+
+// the kernels of get_surface_kernels() against the SDL blitters, on the same ARGB8888 surfaces.
+void bench_surface_kernels() {
+    std::cout << "{\"surface_kernels\":\"" << sdl2::get_surface_kernels().name << "\"}" << std::endl;
+
+    for (int size : SIZES) {
+        sdl2::Surface dst = make_surface(size, size, SDL_PIXELFORMAT_ARGB8888, 255);
+        sdl2::Surface translucent = make_surface(size, size, SDL_PIXELFORMAT_ARGB8888, 128);
+        sdl2::Surface keyed = make_surface(size, size, SDL_PIXELFORMAT_ARGB8888, 255);
+        sdl2::Surface abgr = make_surface(size, size, SDL_PIXELFORMAT_ABGR8888, 255);
+        sdl2::Surface rgb24 = make_surface(size, size, SDL_PIXELFORMAT_RGB24, 255);
+        SDL_Rect rect = { 0, 0, size, size };
+        double pixels = static_cast<double>(size) * size;
+
+        bench(name_of("kernel_fill", "ARGB8888", size), pixels, [&] {
+            sdl2::surface_fill(dst.get(), &rect, 0x80402010);
+        });
+
+        SDL_SetSurfaceBlendMode(translucent.get(), SDL_BLENDMODE_BLEND);
+        bench(name_of("sdl_blend", "ARGB8888", size), pixels, [&] {
+            SDL_Rect dstRect = rect;
+            sdl2::sdl_blit_surface(translucent.get(), nullptr, dst.get(), &dstRect);
+        });
+
+        bench(name_of("kernel_blend", "ARGB8888", size), pixels, [&] {
+            sdl2::surface_blend(translucent.get(), nullptr, dst.get(), 0, 0);
+        });
+
+        bench(name_of("kernel_blend_premultiplied", "ARGB8888", size), pixels, [&] {
+            sdl2::surface_blend_premultiplied(translucent.get(), nullptr, dst.get(), 0, 0);
+        });
+
+        SDL_SetSurfaceBlendMode(keyed.get(), SDL_BLENDMODE_NONE);
+        SDL_SetColorKey(keyed.get(), SDL_TRUE, 0xff000000);
+        bench(name_of("sdl_colorkey", "ARGB8888", size), pixels, [&] {
+            SDL_Rect dstRect = rect;
+            sdl2::sdl_blit_surface(keyed.get(), nullptr, dst.get(), &dstRect);
+        });
+
+        bench(name_of("kernel_colorkey", "ARGB8888", size), pixels, [&] {
+            sdl2::surface_copy_colorkey(keyed.get(), nullptr, dst.get(), 0, 0, 0xff000000);
+        });
+
+        SDL_SetSurfaceBlendMode(abgr.get(), SDL_BLENDMODE_NONE);
+        bench(name_of("sdl_convert", "ABGR8888", size), pixels, [&] {
+            SDL_Rect dstRect = rect;
+            sdl2::sdl_blit_surface(abgr.get(), nullptr, dst.get(), &dstRect);
+        });
+
+        bench(name_of("kernel_convert", "ABGR8888", size), pixels, [&] {
+            sdl2::surface_convert(abgr.get(), dst.get());
+        });
+
+        bench(name_of("kernel_convert", "RGB24", size), pixels, [&] {
+            sdl2::surface_convert(rgb24.get(), dst.get());
+        });
+    }
+}
+
+// the same frame composited with 1 to 8 threads, at 1080p and 4K, to show how the tiles scale with the cores.
+void bench_compositor() {
+    const int RESOLUTIONS[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    const unsigned THREADS[] = { 1, 2, 4, 8 };
+    const int SPRITE_NUM = 500;
+
+    sdl2::Surface sprite = make_surface(128, 128, SDL_PIXELFORMAT_ARGB8888, 160);
+
+    for (const auto& resolution : RESOLUTIONS) {
+        int w = resolution[0];
+        int h = resolution[1];
+        sdl2::Surface target = make_surface(w, h, SDL_PIXELFORMAT_ARGB8888, 255);
+        double pixels = static_cast<double>(w) * h;
+        std::string size = std::to_string(w) + "x" + std::to_string(h);
+
+        for (unsigned threadNum : THREADS) {
+            sdl2::Compositor compositor{ 128, threadNum };
+
+            bench("compositor/" + size + "/threads_" + std::to_string(threadNum), pixels, [&] {
+                compositor.begin(target.get());
+                compositor.fill(nullptr, 0xff203040);
+                for (int i = 0; i < SPRITE_NUM; ++i) {
+                    compositor.blend(sprite.get(), nullptr, (i * 97) % w, (i * 61) % h);
+                }
+
+                compositor.composite();
+            });
+        }
+    }
+}
+
+void bench_textures(sdl2::Renderer& renderer) {
+    for (int size : SIZES) {
+        sdl2::Surface surface = make_surface(size, size, SDL_PIXELFORMAT_ARGB8888, 255);
+        double pixels = static_cast<double>(size) * size;
+
+        bench(name_of("texture_create", "ARGB8888", size), pixels, [&] {
+            sdl2::Texture texture = sdl2::sdl_create_texture_from_surface(renderer, surface.get());
+        });
+
+        // the same pixels per frame, into a streaming texture instead of a new one.
+        sdl2::StreamingTexture streaming{ renderer, size, size };
+        bench(name_of("streaming_update", "ARGB8888", size), pixels, [&] {
+            streaming.update(nullptr, surface->pixels, surface->pitch);
+            streaming.swap();
+        });
+
+        bench(name_of("streaming_lock", "ARGB8888", size), pixels, [&] {
+            sdl2::StreamingTexture::Lock lock = streaming.lock();
+            for (int y = 0; y < size; ++y) {
+                memcpy(lock.row(y), static_cast<uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch, size * 4);
+            }
+        });
+    }
+
+    const int SPRITE_NUM = 1000;
+    sdl2::Surface sprite = make_surface(64, 64, SDL_PIXELFORMAT_ARGB8888, 200);
+    sdl2::Texture texture = sdl2::sdl_create_texture_from_surface(renderer, sprite.get());
+    SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND);
+
+    bench("render_copy/64x64/1000", SPRITE_NUM, [&] {
+        for (int i = 0; i < SPRITE_NUM; ++i) {
+            SDL_Rect dstRect = { (i * 37) % (WINDOW_WIDTH - 64), (i * 91) % (WINDOW_HEIGHT - 64), 64, 64 };
+            sdl2::sdl_render_copy(renderer, texture, nullptr, &dstRect);
+        }
+    });
+
+    const double ANGLES[] = { 0, 45 };
+    for (double angle : ANGLES) {
+        bench("render_copy_ex/64x64/1000/" + std::to_string(static_cast<int>(angle)), SPRITE_NUM, [&] {
+            for (int i = 0; i < SPRITE_NUM; ++i) {
+                SDL_Rect dstRect = { (i * 37) % (WINDOW_WIDTH - 64), (i * 91) % (WINDOW_HEIGHT - 64), 64, 64 };
+                sdl2::sdl_render_copy_ex(renderer, texture, nullptr, &dstRect, angle, nullptr, SDL_FLIP_HORIZONTAL);
+            }
+        });
+    }
+
+    // the same sprites through an Atlas and one SpriteBatch.
+    sdl2::Atlas atlas{ 256, 256 };
+    sdl2::AtlasRegion region = atlas.add(renderer, sprite.get());
+    sdl2::SpriteBatch batch{ renderer, SPRITE_NUM };
+
+    bench("sprite_batch/64x64/1000", SPRITE_NUM, [&] {
+        for (int i = 0; i < SPRITE_NUM; ++i) {
+            SDL_FRect dstRect = { static_cast<float>((i * 37) % (WINDOW_WIDTH - 64)), static_cast<float>((i * 91) % (WINDOW_HEIGHT - 64)), 64, 64 };
+            batch.draw(atlas, region, dstRect);
+        }
+
+        batch.flush();
+    });
+
+    // 50k small rotated sprites a frame, one call each against one batch.
+    const int ROTATED_NUM = 50000;
+    sdl2::Surface smallSprite = make_surface(16, 16, SDL_PIXELFORMAT_ARGB8888, 200);
+    sdl2::Texture smallTexture = sdl2::sdl_create_texture_from_surface(renderer, smallSprite.get());
+    SDL_SetTextureBlendMode(smallTexture.get(), SDL_BLENDMODE_BLEND);
+    const SDL_Rect smallSrc = { 0, 0, 16, 16 };
+
+    bench("render_copy_ex/16x16/50000/rotated", ROTATED_NUM, [&] {
+        for (int i = 0; i < ROTATED_NUM; ++i) {
+            SDL_Rect dstRect = { (i * 37) % (WINDOW_WIDTH - 16), (i * 91) % (WINDOW_HEIGHT - 16), 16, 16 };
+            sdl2::sdl_render_copy_ex(renderer, smallTexture, &smallSrc, &dstRect, i % 360, nullptr, i % 2 == 0 ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL);
+        }
+    });
+
+    sdl2::SpriteBatch rotatedBatch{ renderer, ROTATED_NUM };
+    bench("sprite_batch/16x16/50000/rotated", ROTATED_NUM, [&] {
+        for (int i = 0; i < ROTATED_NUM; ++i) {
+            SDL_FRect dstRect = { static_cast<float>((i * 37) % (WINDOW_WIDTH - 16)), static_cast<float>((i * 91) % (WINDOW_HEIGHT - 16)), 16, 16 };
+            rotatedBatch.draw_ex(smallTexture, smallSrc, dstRect, i % 360, nullptr, i % 2 == 0 ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL);
+        }
+
+        rotatedBatch.flush();
+    });
+}
+
+// a scrolling map of 200k 32x32 objects, about 2% of them inside the view.
+void bench_culling(sdl2::Renderer& renderer) {
+    const int OBJECT_NUM = 200000;
+    const int WORLD_SIZE = 7240;
+    sdl2::Surface sprite = make_surface(32, 32, SDL_PIXELFORMAT_ARGB8888, 255);
+    sdl2::Texture texture = sdl2::sdl_create_texture_from_surface(renderer, sprite.get());
+
+    std::vector<SDL_Rect> bounds(OBJECT_NUM);
+    for (int i = 0; i < OBJECT_NUM; ++i) {
+        bounds[i] = SDL_Rect{ static_cast<int>((i * 7919u) % WORLD_SIZE), static_cast<int>((i * 104729u) % WORLD_SIZE), 32, 32 };
+    }
+
+    const int cameraX = WORLD_SIZE / 2;
+    const int cameraY = WORLD_SIZE / 2;
+
+    bench("culling/render_copy_all/200000", OBJECT_NUM, [&] {
+        for (const SDL_Rect& b : bounds) {
+            SDL_Rect dstRect = { b.x - cameraX, b.y - cameraY, b.w, b.h };
+            sdl2::sdl_render_copy(renderer, texture, nullptr, &dstRect);
+        }
+    });
+
+    sdl2::SpatialGrid grid{ 256 };
+    for (int i = 0; i < OBJECT_NUM; ++i) {
+        grid.insert(bounds[i]);
+    }
+
+    bench("culling/spatial_grid/200000", OBJECT_NUM, [&] {
+        for (sdl2::SpatialId id : grid.query_view(renderer, static_cast<float>(cameraX), static_cast<float>(cameraY))) {
+            const SDL_Rect& b = bounds[id];
+            SDL_Rect dstRect = { b.x - cameraX, b.y - cameraY, b.w, b.h };
+            sdl2::sdl_render_copy(renderer, texture, nullptr, &dstRect);
+        }
+    });
+
+    sdl2::CullStats stats = grid.get_stats();
+    std::cout << "{\"benchmark\":\"culling/stats\",\"objects\":" << stats.objects << ",\"visible\":" << stats.visible
+              << ",\"culled\":" << stats.culled << ",\"cells_visited\":" << stats.cellsVisited << "}" << std::endl;
+
+    // 10k moving objects a frame, most of them stay in their cells.
+    const int MOVING_NUM = 10000;
+    int frame = 0;
+    bench("culling/spatial_grid_move/10000", MOVING_NUM, [&] {
+        int step = (frame++ % 2 == 0) ? 3 : -3;
+        for (int i = 0; i < MOVING_NUM; ++i) {
+            bounds[i].x += step;
+            grid.move(static_cast<sdl2::SpatialId>(i), bounds[i]);
+        }
+    });
+}
+
+// a 2048x2048 map of 8x8 tiles, the view scrolls 2 pixels a frame.
+void bench_tilemap(sdl2::Renderer& renderer) {
+    const int TILE_SIZE = 8;
+    const int MAP_SIZE = 2048;
+    sdl2::Surface tilesetSurface = make_surface(256, 256, SDL_PIXELFORMAT_ARGB8888, 255);
+    sdl2::Texture tileset = sdl2::sdl_create_texture_from_surface(renderer, tilesetSurface.get());
+    const int COLUMNS = 256 / TILE_SIZE;
+    const int TILES_PER_FRAME = (WINDOW_WIDTH / TILE_SIZE + 1) * (WINDOW_HEIGHT / TILE_SIZE + 1);
+
+    std::vector<uint16_t> tiles(MAP_SIZE * MAP_SIZE);
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; ++i) {
+        tiles[i] = static_cast<uint16_t>((i * 7919u) % (COLUMNS * COLUMNS));
+    }
+
+    int cameraX = 0;
+    bench("tilemap/render_copy_per_tile", TILES_PER_FRAME, [&] {
+        cameraX = (cameraX + 2) % (MAP_SIZE * TILE_SIZE - WINDOW_WIDTH);
+        int tileX0 = cameraX / TILE_SIZE;
+        for (int y = 0; y <= WINDOW_HEIGHT / TILE_SIZE; ++y) {
+            for (int x = tileX0; x <= tileX0 + WINDOW_WIDTH / TILE_SIZE; ++x) {
+                uint16_t tile = tiles[y * MAP_SIZE + x];
+                SDL_Rect srcRect = { (tile % COLUMNS) * TILE_SIZE, (tile / COLUMNS) * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+                SDL_Rect dstRect = { x * TILE_SIZE - cameraX, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+                sdl2::sdl_render_copy(renderer, tileset, &srcRect, &dstRect);
+            }
+        }
+    });
+
+    sdl2::TileMap map{ renderer, tileset, TILE_SIZE, TILE_SIZE, MAP_SIZE, MAP_SIZE };
+    for (int y = 0; y < MAP_SIZE; ++y) {
+        for (int x = 0; x < MAP_SIZE; ++x) {
+            map.set_tile(x, y, tiles[y * MAP_SIZE + x]);
+        }
+    }
+
+    cameraX = 0;
+    bench("tilemap/chunked", TILES_PER_FRAME, [&] {
+        cameraX = (cameraX + 2) % (MAP_SIZE * TILE_SIZE - WINDOW_WIDTH);
+        map.draw(cameraX, 0);
+    });
+
+    // one changed tile a frame, its chunk is rendered again.
+    int frame = 0;
+    bench("tilemap/chunked_one_edit", TILES_PER_FRAME, [&] {
+        ++frame;
+        map.set_tile((cameraX / TILE_SIZE) + frame % 64, frame % 64, static_cast<uint16_t>(frame % (COLUMNS * COLUMNS)));
+        map.draw(cameraX, 0);
+    });
+
+    sdl2::TileMapStats stats = map.get_stats();
+    std::cout << "{\"benchmark\":\"tilemap/stats\",\"chunk_textures\":" << map.texture_count() << ",\"textures_created\":" << stats.texturesCreated
+              << ",\"evictions\":" << stats.evictions << "}" << std::endl;
+}
+
+// a text sized and a screen sized scratch surface per frame, from the heap, a PixelPool and a FrameArena.
+void bench_pixel_pool() {
+    const int SIZES_WH[][2] = { { 256, 32 }, { WINDOW_WIDTH, WINDOW_HEIGHT } };
+    sdl2::PixelPool pool;
+    sdl2::FrameArena arena{ 2 * static_cast<size_t>(WINDOW_WIDTH) * WINDOW_HEIGHT * 4 };
+
+    for (const auto& size : SIZES_WH) {
+        int w = size[0];
+        int h = size[1];
+        std::string suffix = std::to_string(w) + "x" + std::to_string(h);
+
+        bench("surface_alloc/sdl/" + suffix, 1, [&] {
+            sdl2::Surface surface{ SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888) };
+        });
+
+        bench("surface_alloc/pixel_pool/" + suffix, 1, [&] {
+            sdl2::Surface surface = pool.create_surface(w, h, SDL_PIXELFORMAT_ARGB8888);
+        });
+
+        bench("surface_alloc/frame_arena/" + suffix, 1, [&] {
+            arena.reset();
+            sdl2::Surface surface = arena.create_surface(w, h, SDL_PIXELFORMAT_ARGB8888);
+        });
+    }
+
+    // the SDL allocations left per pooled surface, the SDL_Surface struct itself.
+    const int SURFACE_NUM = 1000;
+    sdl2::SDLMemoryCounter counter;
+    for (int i = 0; i < SURFACE_NUM; ++i) {
+        sdl2::Surface surface = pool.create_surface(256, 32, SDL_PIXELFORMAT_ARGB8888);
+    }
+
+    sdl2::SDLMemoryCounts counts = sdl2::SDLMemoryCounter::get_counts();
+    sdl2::PixelAllocStats stats = pool.get_stats();
+    std::cout << "{\"benchmark\":\"surface_alloc/counts\",\"surfaces\":" << SURFACE_NUM << ",\"sdl_mallocs\":" << counts.mallocs + counts.callocs
+              << ",\"pool_heap_allocations\":" << stats.heapAllocations << "}" << std::endl;
+}
+
+// a scene whose simulation costs as much as its rendering, on one thread then with a RenderThread.
+void bench_render_thread(sdl2::Window& window) {
+    const int RECT_NUM = 20000;
+    auto record = [](sdl2::CommandBuffer& commands) {
+        commands.set_draw_color(0, 0, 0, 255);
+        commands.clear();
+        commands.set_draw_color(255, 128, 0, 255);
+        for (int i = 0; i < RECT_NUM; ++i) {
+            commands.fill_rect(SDL_Rect{ (i * 37) % (WINDOW_WIDTH - 16), (i * 91) % (WINDOW_HEIGHT - 16), 16, 16 });
+        }
+    };
+
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t renderTicks = 0;
+    auto simulate = [&] {
+        uint64_t end = SDL_GetPerformanceCounter() + renderTicks;
+        while (SDL_GetPerformanceCounter() < end) {
+        }
+    };
+
+    {
+        sdl2::Renderer renderer{ window, -1, SDL_RENDERER_SOFTWARE };
+        sdl2::CommandBuffer commands;
+        const int FRAME_NUM = 20;
+        uint64_t begin = SDL_GetPerformanceCounter();
+        for (int i = 0; i < FRAME_NUM; ++i) {
+            record(commands);
+            commands.flush(renderer);
+            sdl2::sdl_render_present(renderer);
+        }
+
+        renderTicks = (SDL_GetPerformanceCounter() - begin) / FRAME_NUM;
+
+        bench("render_thread/single_thread", 1, [&] {
+            simulate();
+            record(commands);
+            commands.flush(renderer);
+            sdl2::sdl_render_present(renderer);
+        });
+    }
+
+    sdl2::RenderThread renderThread{ window, -1, SDL_RENDERER_SOFTWARE };
+    bench("render_thread/render_thread", 1, [&] {
+        simulate();
+        record(renderThread.begin_frame());
+        renderThread.submit();
+    });
+
+    renderThread.finish();
+    sdl2::RenderThreadStats stats = renderThread.get_stats();
+    std::cout << "{\"benchmark\":\"render_thread/stats\",\"simulate_ms\":" << static_cast<double>(renderTicks) * 1000.0 / frequency
+              << ",\"frames\":" << stats.framesPresented << ",\"fence_wait_ms\":" << stats.fenceWaitMilliSeconds << "}" << std::endl;
+}
+
+void bench_primitives(sdl2::Renderer& renderer) {
+    const int RECT_NUM = 10000;
+    std::vector<SDL_Rect> rects;
+    for (int i = 0; i < RECT_NUM; ++i) {
+        rects.emplace_back(SDL_Rect{ (i * 13) % WINDOW_WIDTH, (i * 29) % WINDOW_HEIGHT, 4, 4 });
+    }
+
+    sdl2::sdl_set_render_draw_color(renderer, 57, 197, 187, 255);
+
+    bench("render_fill_rect/loop/10000", RECT_NUM, [&] {
+        for (const auto& rect : rects) {
+            sdl2::sdl_render_fill_rect(renderer, &rect);
+        }
+    });
+
+    bench("render_fill_rect/loop_return_on_error/10000", RECT_NUM, [&] {
+        for (const auto& rect : rects) {
+            sdl2::sdl_render_fill_rect<sdl2::ReturnOnError>(renderer, &rect);
+        }
+    });
+
+    // SDL_assert() only, nothing is checked in release builds.
+    bench("render_fill_rect/loop_assert_on_error/10000", RECT_NUM, [&] {
+        for (const auto& rect : rects) {
+            sdl2::sdl_render_fill_rect<sdl2::AssertOnError>(renderer, &rect);
+        }
+    });
+
+    bench("render_fill_rects/bulk/10000", RECT_NUM, [&] {
+        sdl2::sdl_render_fill_rects(renderer, rects);
+    });
+
+    sdl2::CommandBuffer commands;
+    bench("command_buffer/fill_rect/10000", RECT_NUM, [&] {
+        for (int i = 0; i < RECT_NUM; ++i) {
+            commands.set_draw_color(static_cast<uint8_t>(i & 3), 0, 0, 255);
+            commands.fill_rect(rects[i]);
+        }
+
+        commands.flush(renderer);
+    });
+}
+
+void bench_text(sdl2::Renderer& renderer, const std::string& fontPath) {
+    if (fontPath.empty()) {
+        skip("ttf_render_utf8_blended", "no --font");
+        return;
+    }
+
+    sdl2::Font font{ fontPath, 16 };
+    sdl2::GlyphCache glyphCache{ renderer, font };
+    sdl2::SpriteBatch batch{ renderer };
+    SDL_Color color = { 255, 255, 255, 255 };
+
+    const size_t LENGTHS[] = { 8, 64, 256 };
+    for (size_t length : LENGTHS) {
+        std::string text;
+        for (size_t i = 0; i < length; ++i) {
+            text += static_cast<char>('a' + i % 26);
+        }
+
+        bench("ttf_render_utf8_blended/" + std::to_string(length), static_cast<double>(length), [&] {
+            sdl2::Surface surface = sdl2::ttf_render_utf8_blended(font, text, color);
+        });
+
+        bench("ttf_render_text_solid/" + std::to_string(length), static_cast<double>(length), [&] {
+            sdl2::Surface surface = sdl2::ttf_render_text_solid(font, text, color);
+        });
+
+        bench("glyph_cache/" + std::to_string(length), static_cast<double>(length), [&] {
+            glyphCache.draw(batch, text, 0, 0, color);
+            batch.flush();
+        });
+    }
+}
+
+void bench_loading(const Options& options) {
+    if (options.image.empty()) {
+        skip("img_load", "no --image");
+    }
+    else {
+        bench("img_load", 1, [&] {
+            sdl2::Surface surface = sdl2::img_load(options.image);
+        });
+    }
+
+    const std::string* sounds[] = { &options.wav, &options.ogg };
+    const char* names[] = { "mix_load_wav_rw/wav", "mix_load_wav_rw/ogg" };
+    for (int i = 0; i < 2; ++i) {
+        if (sounds[i]->empty()) {
+            skip(names[i], "no asset");
+            continue;
+        }
+
+        bench(names[i], 1, [&] {
+            sdl2::MixChunk chunk = sdl2::mix_load_wav_rw(sdl2::sdl_rw_from_file(*sounds[i], "rb"), 1);
+        });
+    }
+
+    // a streamed MixMusic against the fully decoded MixChunk of the same track.
+    if (options.ogg.empty()) {
+        skip("mix_load_mus/ogg", "no --ogg");
+        return;
+    }
+
+    bench("mix_load_mus/ogg", 1, [&] {
+        sdl2::MixMusic music{ options.ogg };
+    });
+
+    sdl2::MixChunk chunk = sdl2::mix_load_wav_rw(sdl2::sdl_rw_from_file(options.ogg, "rb"), 1);
+    SDL_RWops* ops = sdl2::sdl_rw_from_file(options.ogg, "rb");
+    Sint64 fileBytes = SDL_RWsize(ops);
+    SDL_RWclose(ops);
+
+    // the music keeps the decoder state and the file open, roughly the file size at most.
+    std::cout << "{\"benchmark\":\"music_memory/ogg\",\"chunk_pcm_bytes\":" << chunk.get()->alen
+              << ",\"music_source_bytes\":" << fileBytes << "}" << std::endl;
+}
+
+/*
+    opening many small assets one file at a time against one mapped pack.
+    the files are written next to the program and removed after, the page cache is warm for both,
+    so this measures the per file syscalls and not the disk.
+*/
+void bench_pack_startup() {
+    const int ASSET_NUM = 1000;
+    const std::string PACK_PATH = "bench_assets.pack";
+
+    sdl2::Surface icon = make_surface(32, 32, SDL_PIXELFORMAT_ARGB8888, 255);
+    std::vector<std::string> paths;
+    sdl2::AssetPackWriter writer;
+    for (int i = 0; i < ASSET_NUM; ++i) {
+        paths.push_back("bench_asset_" + std::to_string(i) + ".bmp");
+        if (SDL_SaveBMP(icon.get(), paths.back().c_str()) < 0) {
+            skip("startup", "can't write the asset files");
+            return;
+        }
+
+        writer.add_file(paths.back(), paths.back());
+    }
+
+    writer.write(PACK_PATH);
+
+    bench("startup/loose_files/" + std::to_string(ASSET_NUM), ASSET_NUM, [&] {
+        for (const std::string& path : paths) {
+            sdl2::Surface surface{ SDL_LoadBMP(path.c_str()) };
+        }
+    });
+
+    bench("startup/asset_pack/" + std::to_string(ASSET_NUM), ASSET_NUM, [&] {
+        sdl2::AssetPack pack{ PACK_PATH };
+        for (const std::string& path : paths) {
+            sdl2::Surface surface{ SDL_LoadBMP_RW(pack.get(path).rw(), 1) };
+        }
+    });
+
+    for (const std::string& path : paths) {
+        std::remove(path.c_str());
+    }
+
+    std::remove(PACK_PATH.c_str());
+}
+
+// decode + convert + upload (cold) against map + upload (warm), on --image or a generated 1024x1024 bmp.
+void bench_texture_cache(sdl2::Renderer& renderer, const Options& options) {
+    std::string source = options.image;
+    if (source.empty()) {
+        source = "bench_texture_cache_source.bmp";
+        sdl2::Surface surface = make_surface(1024, 1024, SDL_PIXELFORMAT_ARGB8888, 255);
+        if (SDL_SaveBMP(surface.get(), source.c_str()) < 0) {
+            skip("texture_cache", "can't write the source image");
+            return;
+        }
+    }
+
+    sdl2::TextureDiskCache cache{ "." };
+    std::string entryPath = cache.entry_path(renderer, source);
+
+    bench("texture_cache/cold", 1, [&] {
+        std::remove(entryPath.c_str());
+        sdl2::Texture texture = cache.load(renderer, source);
+    });
+
+    bench("texture_cache/warm", 1, [&] {
+        sdl2::Texture texture = cache.load(renderer, source);
+    });
+
+    bench("texture_cache/img_load_and_create", 1, [&] {
+        sdl2::Surface surface = sdl2::img_load(source);
+        sdl2::Texture texture = sdl2::sdl_create_texture_from_surface(renderer, surface.get());
+    });
+
+    std::remove(entryPath.c_str());
+    if (options.image.empty()) {
+        std::remove(source.c_str());
+    }
+}
+
+// mixing cost per voice, items are voice frames. the mixer isn't hooked to the device, mix() runs here.
+void bench_voice_mixer() {
+    const int FRAME_NUM = 1024;
+    const int VOICE_NUMS[] = { 1, 64, 256 };
+
+    std::vector<int16_t> pcm(2 * DEFAULT_FREQUENCY);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        pcm[i] = static_cast<int16_t>((i * 613) % 20000 - 10000);
+    }
+
+    sdl2::MixChunk chunk{ Mix_QuickLoad_RAW(reinterpret_cast<uint8_t*>(pcm.data()), static_cast<uint32_t>(pcm.size() * sizeof(int16_t))) };
+    std::vector<int16_t> stream(2 * FRAME_NUM);
+
+    for (int voiceNum : VOICE_NUMS) {
+        sdl2::VoiceMixer mixer{ 256, 1024, false };
+        for (int i = 0; i < voiceNum; ++i) {
+            mixer.play(chunk, 0.5f, (i % 3) - 1.0f, 0, -1);
+        }
+
+        bench("voice_mixer/voices_" + std::to_string(voiceNum), static_cast<double>(voiceNum) * FRAME_NUM, [&] {
+            mixer.mix(stream.data(), FRAME_NUM);
+        });
+    }
+}
+
+struct FloodHandler : sdl2::EventHandler<FloodHandler> {
+    uint64_t motions = 0;
+    uint64_t keys = 0;
+
+    void on_mouse_motion(const SDL_MouseMotionEvent& e, uint64_t) {
+        motions += static_cast<uint64_t>(e.xrel);
+    }
+
+    void on_key_down(const SDL_KeyboardEvent&, uint64_t) {
+        ++keys;
+    }
+};
+
+// an input flood of 4096 mouse motion and key events per frame, the push alone is the baseline.
+void bench_events() {
+    const int EVENT_NUM = 4096;
+    std::vector<SDL_Event> flood(EVENT_NUM);
+    for (int i = 0; i < EVENT_NUM; ++i) {
+        SDL_Event& event = flood[i];
+        SDL_zero(event);
+        event.type = i % 8 == 0 ? SDL_KEYDOWN : SDL_MOUSEMOTION;
+        event.motion.xrel = 1;
+    }
+
+    auto push = [&] {
+        SDL_PeepEvents(flood.data(), EVENT_NUM, SDL_ADDEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+    };
+
+    SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+    bench("events/push_only", EVENT_NUM, [&] {
+        push();
+        SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+    });
+
+    uint64_t motions = 0;
+    uint64_t keys = 0;
+    std::unordered_map<uint32_t, std::function<void(const SDL_Event&)>> handlers;
+    handlers[SDL_MOUSEMOTION] = [&](const SDL_Event& e) { motions += static_cast<uint64_t>(e.motion.xrel); };
+    handlers[SDL_KEYDOWN] = [&](const SDL_Event&) { ++keys; };
+
+    bench("events/poll_event_function_map", EVENT_NUM, [&] {
+        push();
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            auto it = handlers.find(event.type);
+            if (it != handlers.end()) {
+                it->second(event);
+            }
+        }
+    });
+
+    sdl2::EventDispatcher dispatcher;
+    FloodHandler handler;
+    bench("events/event_dispatcher", EVENT_NUM, [&] {
+        push();
+        dispatcher.poll(handler);
+    });
+}
+
+Uint32 empty_timer_callback(Uint32, void*) {
+    return 0;
+}
+
+void bench_timers() {
+    bench("sdl_get_performance_counter", 1, [] {
+        volatile uint64_t counter = SDL_GetPerformanceCounter();
+        (void)counter;
+    });
+
+    bench("sdl_get_ticks", 1, [] {
+        volatile uint32_t ticks = SDL_GetTicks();
+        (void)ticks;
+    });
+
+    bench("timer_add_remove", 1, [] {
+        sdl2::Timer timer{ 1000, empty_timer_callback, nullptr };
+    });
+
+    // 100k timers spread over 1 ms .. 10 s, like a game with many cooldowns and effects.
+    const int TIMER_NUM = 100000;
+    std::vector<uint32_t> intervals(TIMER_NUM);
+    for (int i = 0; i < TIMER_NUM; ++i) {
+        intervals[i] = 1 + static_cast<uint32_t>((i * 7919u) % 10000);
+    }
+
+    bench("timers/sdl_add_remove_100k", TIMER_NUM, [&] {
+        std::vector<sdl2::Timer> timers;
+        timers.reserve(TIMER_NUM);
+        for (int i = 0; i < TIMER_NUM; ++i) {
+            timers.emplace_back(intervals[i] + 60000, empty_timer_callback, nullptr);
+        }
+    });
+
+    sdl2::TimerWheel wheel;
+    std::vector<sdl2::TimerHandle> handles(TIMER_NUM);
+    bench("timers/timer_wheel_add_cancel_100k", TIMER_NUM, [&] {
+        for (int i = 0; i < TIMER_NUM; ++i) {
+            handles[i] = wheel.add(intervals[i], empty_timer_callback, nullptr);
+        }
+
+        for (int i = 0; i < TIMER_NUM; ++i) {
+            wheel.cancel(handles[i]);
+        }
+    });
+
+    // one 60 fps frame of the wheel with 100k repeating timers active.
+    auto repeat = [](Uint32 interval, void*) -> Uint32 {
+        return interval;
+    };
+
+    for (int i = 0; i < TIMER_NUM; ++i) {
+        wheel.add(intervals[i], repeat, nullptr);
+    }
+
+    bench("timers/timer_wheel_frame_100k", 1, [&] {
+        wheel.advance(16);
+    });
+
+    wheel.clear();
+}
+
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--font") == 0) {
+            options.font = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--image") == 0) {
+            options.image = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--wav") == 0) {
+            options.wav = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--ogg") == 0) {
+            options.ogg = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--min-time") == 0) {
+            options.minSeconds = atof(argv[i + 1]);
+        }
+    }
+
+    return options;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parse_options(argc, argv);
+        g_minSeconds = options.minSeconds;
+
+        // headless, must be set before SDL_Init().
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+
+        sdl2::SDL2Env env{ SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER };
+        sdl2::SDL2TTF ttf;
+        sdl2::SDL2Mixer mixer;
+        sdl2::MixOpenAudio moa{ DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, DEFAULT_CHANNEL_NUM, DEFAULT_CHUNK_SIZE };
+
+        // a window can't have both a window surface and a renderer.
+        sdl2::Window surfaceWindow{ "benchmarks", 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0 };
+        bench_surfaces(sdl2::sdl_window_get_surface(surfaceWindow));
+        bench_surface_kernels();
+        bench_compositor();
+        bench_pixel_pool();
+
+        sdl2::Window renderWindow{ "benchmarks", 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0 };
+        sdl2::Renderer renderer{ renderWindow, -1, SDL_RENDERER_SOFTWARE };
+        bench_textures(renderer);
+        bench_culling(renderer);
+        bench_tilemap(renderer);
+        bench_primitives(renderer);
+        bench_text(renderer, options.font);
+        bench_loading(options);
+        bench_pack_startup();
+        bench_texture_cache(renderer, options);
+        bench_voice_mixer();
+        bench_events();
+        bench_timers();
+
+        sdl2::Window threadWindow{ "benchmarks", 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0 };
+        bench_render_thread(threadWindow);
+    }
+    catch(const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
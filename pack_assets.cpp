@@ -0,0 +1,45 @@
+/*
+    packs files into one asset pack for sdl2::AssetPack, the asset names are the paths as given:
+
+        pack_assets out.pack images/a.png images/b.png fonts/c.ttf ...
+        pack_assets out.pack --align 4096 video/intro.bin
+
+    --align applies to the files after it, the default is 16 bytes.
+*/
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include "sdl2_wrapper.hpp"
+
+#undef main
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: pack_assets out.pack [--align bytes] files...\n";
+        return 1;
+    }
+
+    try {
+        sdl2::AssetPackWriter writer;
+        uint32_t alignment = 16;
+
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--align" && i + 1 < argc) {
+                alignment = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else {
+                writer.add_file(arg, arg, alignment);
+            }
+        }
+
+        writer.write(argv[1]);
+        std::cout << "packed " << writer.size() << " files into " << argv[1] << "\n";
+    }
+    catch(const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+/*
+    binary size of the error policies: the same frame is compiled once per policy, then the sizes are compared.
+
+        g++ -std=c++11 -O2 -DNDEBUG -DPOLICY=ThrowOnError -c policy_size.cpp $(sdl2-config --cflags) -o throw.o
+        g++ -std=c++11 -O2 -DNDEBUG -DPOLICY=ReturnOnError -c policy_size.cpp $(sdl2-config --cflags) -o return.o
+        g++ -std=c++11 -O2 -DNDEBUG -DPOLICY=AssertOnError -c policy_size.cpp $(sdl2-config --cflags) -o assert.o
+        size throw.o return.o assert.o
+        nm -C --size-sort -S throw.o return.o assert.o | grep draw_frame
+
+    CMakeLists.txt builds the same 3 objects, policy_size_ThrowOnError and so on, with the flags of the build type.
+
+    only draw_frame() and blit_frame() change between the objects. they are compiled, not linked, so no SDL libraries are needed,
+    but the real SDL headers are: the `size` totals change with the header and SDL versions, so compare the 2 symbols
+    and quote numbers only with the SDL version they were built against.
+    the run time of the policies is measured by benchmarks.cpp (render_fill_rect/loop*).
+*/
+#include <vector>
+#include "sdl2_wrapper.hpp"
+
+#ifndef POLICY
+#define POLICY ThrowOnError
+#endif
+
+// the per-frame calls of a typical game frame.
+void draw_frame(sdl2::Renderer& renderer, sdl2::Texture& texture, const std::vector<SDL_Rect>& rects, double angle) {
+    sdl2::sdl_set_render_draw_color<sdl2::POLICY>(renderer, 0, 0, 0, 255);
+    sdl2::sdl_render_clear<sdl2::POLICY>(renderer);
+
+    for (const SDL_Rect& rect : rects) {
+        sdl2::sdl_render_copy<sdl2::POLICY>(renderer, texture, nullptr, &rect);
+        sdl2::sdl_render_copy_ex<sdl2::POLICY>(renderer, texture, nullptr, &rect, angle, nullptr, SDL_FLIP_NONE);
+    }
+
+    sdl2::sdl_set_render_draw_color<sdl2::POLICY>(renderer, 255, 255, 255, 255);
+    for (const SDL_Rect& rect : rects) {
+        sdl2::sdl_render_fill_rect<sdl2::POLICY>(renderer, &rect);
+        sdl2::sdl_render_draw_rect<sdl2::POLICY>(renderer, &rect);
+    }
+
+    sdl2::sdl_render_present(renderer);
+}
+
+// the software path of the same frame.
+void blit_frame(SDL_Surface* screen, SDL_Surface* sprite, const std::vector<SDL_Rect>& rects) {
+    sdl2::sdl_fill_rect<sdl2::POLICY>(screen, nullptr, 0);
+
+    for (const SDL_Rect& rect : rects) {
+        SDL_Rect dstRect = rect;
+        sdl2::sdl_blit_surface<sdl2::POLICY>(sprite, nullptr, screen, &dstRect);
+    }
+}
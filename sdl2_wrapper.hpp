@@ -6,14 +6,50 @@
 #define __SDL2_WRAPPER_HPP__
 
 #include <string>
+#include <vector>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <deque>
+#include <list>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <type_traits>
+#include <atomic>
+#include <ostream>
 #include <exception>
 #include <cstdint>
+#include <climits>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
 
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <SDL_mixer.h>
 
+// SSE2 is always there on x86-64, AVX2 code is compiled per function and picked at runtime.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SDL2_WRAPPER_SSE2 1
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SDL2_WRAPPER_TARGET_AVX2
+#else
+#define SDL2_WRAPPER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 /******************************* sdl2 part. **********************************/
 namespace sdl2 {
     class SDL2Exception : public std::exception {
@@ -45,6 +81,344 @@ namespace sdl2 {
         }
     };
 
+    /*
+        kept out of line, so the string building and the unwind code stay out of the callers.
+        TTF_GetError() and Mix_GetError() are both SDL_GetError().
+    */
+#if defined(_MSC_VER)
+    [[noreturn]] __declspec(noinline) inline void throw_sdl2_exception(const char* userMsg) {
+#else
+    [[noreturn]] __attribute__((noinline, cold)) inline void throw_sdl2_exception(const char* userMsg) {
+#endif
+        const char* sdlErrMsg = SDL_GetError();
+        throw SDL2Exception{ userMsg, sdlErrMsg };
+    }
+
+    /*
+        error policies of the free functions, chosen per call at compile time:
+
+            sdl2::sdl_render_copy(renderer, texture, nullptr, &rect);                              // throws SDL2Exception, the default.
+            int ret = sdl2::sdl_render_copy<sdl2::ReturnOnError>(renderer, texture, nullptr, &rect);   // returns what SDL returns.
+            sdl2::sdl_render_copy<sdl2::AssertOnError>(renderer, texture, nullptr, &rect);         // SDL_assert() in debug builds, nothing in release.
+
+        the functions returning a wrapper (Texture, Surface, MixChunk...) return an empty one on failure
+        with ReturnOnError and AssertOnError, check get() == nullptr and SDL_GetError() yourself.
+        the RAII classes always throw from their constructors, a constructor has no other way to fail.
+    */
+    struct ThrowOnError {
+        typedef void result_type;
+
+        static void check(int ret, const char* userMsg) {
+            if (ret < 0) {
+                throw_sdl2_exception(userMsg);
+            }
+        }
+
+        static void check_ptr(const void* ptr, const char* userMsg) {
+            if (ptr == nullptr) {
+                throw_sdl2_exception(userMsg);
+            }
+        }
+    };
+
+    struct ReturnOnError {
+        typedef int result_type;
+
+        static int check(int ret, const char*) noexcept {
+            return ret;
+        }
+
+        static void check_ptr(const void*, const char*) noexcept {}
+    };
+
+    struct AssertOnError {
+        typedef void result_type;
+
+        static void check(int ret, const char* userMsg) noexcept {
+            (void)ret;
+            (void)userMsg;
+            SDL_assert(ret >= 0 && userMsg);
+        }
+
+        static void check_ptr(const void* ptr, const char* userMsg) noexcept {
+            (void)ptr;
+            (void)userMsg;
+            SDL_assert(ptr != nullptr && userMsg);
+        }
+    };
+
+    /*
+        opt-in profiler, define SDL2_WRAPPER_PROFILE before including this header to enable it.
+        the wrapper functions then record their calls, time and uploaded bytes into a lock-free ring buffer
+        per thread, the user code can add its own scopes with SDL2_PROFILE_SCOPE("name").
+        every sdl_render_* draw call is recorded, the state setters are not.
+        a thread which exits hands its ring to the next thread which records, so the rings are as many
+        as the threads alive at once, and a ring id of the trace may show several threads one after the other.
+        sdl_render_present() and sdl_update_window_surface() mark the end of a frame.
+        without SDL2_WRAPPER_PROFILE all the macros expand to nothing.
+    */
+#define SDL2_PROFILE_CONCAT_IMPL(a, b) a##b
+#define SDL2_PROFILE_CONCAT(a, b) SDL2_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef SDL2_WRAPPER_PROFILE
+#ifndef SDL2_WRAPPER_PROFILE_RING_SIZE
+#define SDL2_WRAPPER_PROFILE_RING_SIZE 65536
+#endif
+
+#define SDL2_PROFILE_SCOPE(name) sdl2::ProfileScope SDL2_PROFILE_CONCAT(sdl2ProfileScope, __LINE__){ name, 0 }
+#define SDL2_PROFILE_UPLOAD(name, bytes) sdl2::ProfileScope SDL2_PROFILE_CONCAT(sdl2ProfileScope, __LINE__){ name, static_cast<uint64_t>(bytes) }
+#define SDL2_PROFILE_FRAME() sdl2::Profiler::frame()
+
+    struct ProfileEvent {
+        const char* name;      // must be a string literal, or live as long as the profiler.
+        uint64_t begin;        // SDL_GetPerformanceCounter() ticks.
+        uint64_t end;
+        uint64_t bytes;
+        uint32_t frame;
+    };
+
+    /*
+        written only by its own thread, read by anyone while it is written.
+        each slot is a seqlock: its sequence is odd while the event i is written, 2 * i + 2 once it is complete,
+        a reader keeps an event only if the sequence was 2 * i + 2 before and after reading it.
+    */
+    class ProfileRing {
+        struct Slot {
+            std::atomic<uint64_t> seq;
+            std::atomic<const char*> name;
+            std::atomic<uint64_t> begin;
+            std::atomic<uint64_t> end;
+            std::atomic<uint64_t> bytes;
+            std::atomic<uint32_t> frame;
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        size_t size;
+        std::atomic<uint64_t> head;
+        uint32_t threadId;
+    public:
+        ProfileRing(uint32_t _threadId)
+            : slots{ new Slot[SDL2_WRAPPER_PROFILE_RING_SIZE]() }, size{ SDL2_WRAPPER_PROFILE_RING_SIZE }, head{ 0 }, threadId{ _threadId }
+        {}
+
+        void push(const ProfileEvent& event) noexcept {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            Slot& slot = slots[h % size];
+
+            slot.seq.store(2 * h + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.name.store(event.name, std::memory_order_relaxed);
+            slot.begin.store(event.begin, std::memory_order_relaxed);
+            slot.end.store(event.end, std::memory_order_relaxed);
+            slot.bytes.store(event.bytes, std::memory_order_relaxed);
+            slot.frame.store(event.frame, std::memory_order_relaxed);
+            slot.seq.store(2 * h + 2, std::memory_order_release);
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        // visits the events still in the ring, oldest first. the events overwritten meanwhile are skipped.
+        template <typename F>
+        void for_each(F f) const {
+            uint64_t h = head.load(std::memory_order_acquire);
+            uint64_t begin = h > size ? h - size : 0;
+            for (uint64_t i = begin; i < h; ++i) {
+                const Slot& slot = slots[i % size];
+                if (slot.seq.load(std::memory_order_acquire) != 2 * i + 2) {
+                    continue;
+                }
+
+                ProfileEvent e;
+                e.name = slot.name.load(std::memory_order_relaxed);
+                e.begin = slot.begin.load(std::memory_order_relaxed);
+                e.end = slot.end.load(std::memory_order_relaxed);
+                e.bytes = slot.bytes.load(std::memory_order_relaxed);
+                e.frame = slot.frame.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (slot.seq.load(std::memory_order_relaxed) == 2 * i + 2) {
+                    f(e);
+                }
+            }
+        }
+
+        uint32_t thread_id() const noexcept {
+            return threadId;
+        }
+    };
+
+    struct ProfileSummary {
+        std::string name;
+        uint64_t calls;
+        uint64_t nanoSeconds;
+        uint64_t bytes;
+    };
+
+    class Profiler {
+        static std::mutex& registry_mutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static std::vector<std::unique_ptr<ProfileRing>>& registry() {
+            static std::vector<std::unique_ptr<ProfileRing>> rings;
+            return rings;
+        }
+
+        // the rings of the threads which exited, handed to the next new threads.
+        static std::vector<ProfileRing*>& free_rings() {
+            static std::vector<ProfileRing*> rings;
+            return rings;
+        }
+
+        static std::atomic<uint32_t>& frame_counter() {
+            static std::atomic<uint32_t> frame{ 0 };
+            return frame;
+        }
+
+        // gives the ring back when its thread exits, its events stay readable until the ring is reused.
+        struct LocalRing {
+            ProfileRing* ring;
+
+            ~LocalRing() {
+                if (ring) {
+                    std::lock_guard<std::mutex> lock{ registry_mutex() };
+                    free_rings().push_back(ring);
+                }
+            }
+        };
+
+        // the ring of the calling thread, taken on first use.
+        static ProfileRing& local() {
+            static thread_local LocalRing local{ nullptr };
+            if (local.ring == nullptr) {
+                std::lock_guard<std::mutex> lock{ registry_mutex() };
+                if (!free_rings().empty()) {
+                    local.ring = free_rings().back();
+                    free_rings().pop_back();
+                }
+                else {
+                    registry().emplace_back(new ProfileRing{ static_cast<uint32_t>(registry().size()) });
+                    local.ring = registry().back().get();
+                }
+            }
+
+            return *local.ring;
+        }
+
+        // writes s as a JSON string, a scope name may hold quotes or backslashes.
+        static void write_json_string(std::ostream& out, const char* s) {
+            out << '"';
+            for (; *s; ++s) {
+                unsigned char c = static_cast<unsigned char>(*s);
+                if (c == '"' || c == '\\') {
+                    out << '\\' << *s;
+                }
+                else if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out << escaped;
+                }
+                else {
+                    out << *s;
+                }
+            }
+
+            out << '"';
+        }
+    public:
+        static void record(const char* name, uint64_t begin, uint64_t end, uint64_t bytes, uint32_t frame) {
+            local().push(ProfileEvent{ name, begin, end, bytes, frame });
+        }
+
+        static void frame() noexcept {
+            frame_counter().fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static uint32_t frame_index() noexcept {
+            return frame_counter().load(std::memory_order_relaxed);
+        }
+
+        // per name totals of one frame, the last complete frame by default.
+        static std::vector<ProfileSummary> summary(uint32_t frame = UINT32_MAX) {
+            if (frame == UINT32_MAX) {
+                frame = frame_index() - 1;
+            }
+
+            double nsPerTick = 1e9 / SDL_GetPerformanceFrequency();
+            std::vector<ProfileSummary> result;
+            std::lock_guard<std::mutex> lock{ registry_mutex() };
+
+            for (const auto& ring : registry()) {
+                ring->for_each([&](const ProfileEvent& e) {
+                    if (e.frame != frame) {
+                        return;
+                    }
+
+                    auto it = std::find_if(result.begin(), result.end(), [&e](const ProfileSummary& s) { return s.name == e.name; });
+                    if (it == result.end()) {
+                        result.push_back(ProfileSummary{ e.name, 0, 0, 0 });
+                        it = result.end() - 1;
+                    }
+
+                    ++it->calls;
+                    it->nanoSeconds += static_cast<uint64_t>((e.end - e.begin) * nsPerTick);
+                    it->bytes += e.bytes;
+                });
+            }
+
+            std::sort(result.begin(), result.end(), [](const ProfileSummary& a, const ProfileSummary& b) { return a.nanoSeconds > b.nanoSeconds; });
+            return result;
+        }
+
+        // every event still in the rings, as Chrome trace_event JSON (chrome://tracing, Perfetto).
+        static void write_chrome_trace(std::ostream& out) {
+            double usPerTick = 1e6 / SDL_GetPerformanceFrequency();
+            bool first = true;
+
+            out << "{\"traceEvents\":[";
+            std::lock_guard<std::mutex> lock{ registry_mutex() };
+
+            for (const auto& ring : registry()) {
+                uint32_t tid = ring->thread_id();
+                ring->for_each([&](const ProfileEvent& e) {
+                    out << (first ? "\n" : ",\n");
+                    out << "{\"name\":";
+                    write_json_string(out, e.name);
+                    out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                        << ",\"ts\":" << static_cast<uint64_t>(e.begin * usPerTick)
+                        << ",\"dur\":" << static_cast<uint64_t>((e.end - e.begin) * usPerTick)
+                        << ",\"args\":{\"frame\":" << e.frame << ",\"bytes\":" << e.bytes << "}}";
+                    first = false;
+                });
+            }
+
+            out << "\n]}\n";
+        }
+    };
+
+    class ProfileScope {
+        const char* name;
+        uint64_t bytes;
+        uint32_t frame;
+        uint64_t begin;
+    public:
+        ProfileScope(const char* _name, uint64_t _bytes) noexcept
+            : name{ _name }, bytes{ _bytes }, frame{ Profiler::frame_index() }, begin{ SDL_GetPerformanceCounter() }
+        {}
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+        ~ProfileScope() {
+            Profiler::record(name, begin, SDL_GetPerformanceCounter(), bytes, frame);
+        }
+    };
+#else
+#define SDL2_PROFILE_SCOPE(name)
+#define SDL2_PROFILE_UPLOAD(name, bytes)
+#define SDL2_PROFILE_FRAME()
+#endif
+
     class SDL2Env {
     public:
         SDL2Env(uint32_t flags) {
@@ -142,34 +516,58 @@ namespace sdl2 {
         }
     };
 
+    // releases pixels a Surface doesn't own, called after SDL_FreeSurface().
+    typedef void (*PixelRelease)(void* pixels, void* context);
+
     class Surface {
         SDL_Surface* surface;
+        PixelRelease release;
+        void* releasePixels;
+        void* releaseContext;
+
+        void destroy() noexcept {
+            if (surface) {
+                SDL_FreeSurface(surface);
+            }
+
+            if (release) {
+                release(releasePixels, releaseContext);
+            }
+        }
     public:
-        Surface() : surface{ nullptr } {}
-        Surface(SDL_Surface* _surf) : surface{ _surf } {}
+        Surface() : surface{ nullptr }, release{ nullptr }, releasePixels{ nullptr }, releaseContext{ nullptr } {}
+        Surface(SDL_Surface* _surf) : surface{ _surf }, release{ nullptr }, releasePixels{ nullptr }, releaseContext{ nullptr } {}
+
+        // for a surface made with SDL_CreateRGBSurfaceWithFormatFrom(), _release(pixels, _context) gives the pixels back.
+        Surface(SDL_Surface* _surf, PixelRelease _release, void* _context)
+            : surface{ _surf }, release{ _release }, releasePixels{ _surf ? _surf->pixels : nullptr }, releaseContext{ _context } {}
 
         Surface(const Surface&) = delete;
         Surface& operator=(const Surface&) = delete;
 
         Surface(Surface && other) noexcept 
-            : surface { other.surface }  
+            : surface { other.surface }, release{ other.release }, releasePixels{ other.releasePixels }, releaseContext{ other.releaseContext }
         {
             other.surface = nullptr;
+            other.release = nullptr;
         }
 
         Surface& operator=(Surface&& other) noexcept {
             if (this != &other) {
+                destroy();
                 surface = other.surface;
+                release = other.release;
+                releasePixels = other.releasePixels;
+                releaseContext = other.releaseContext;
                 other.surface = nullptr;
+                other.release = nullptr;
             }
 
             return *this;
         }
 
         ~Surface () {
-            if (surface) {
-                SDL_FreeSurface(surface);
-            }
+            destroy();
         }
 
         SDL_Surface* get() noexcept {
@@ -185,6 +583,348 @@ namespace sdl2 {
         }
     };
 
+    struct PixelAllocStats {
+        size_t requests;           // pixel buffers handed out.
+        size_t heapAllocations;    // of them, the ones which needed a new heap block, 0 in a steady state.
+        size_t liveBuffers;        // buffers handed out and not given back yet.
+        size_t reservedBytes;      // PixelPool: bytes kept for reuse, FrameArena: bytes used this frame.
+    };
+
+    namespace kernels {
+        // a cache line, SDL_SIMDAlloc() only guarantees SDL_SIMDGetAlignment() which may be 16 bytes.
+        const size_t PIXEL_ALIGNMENT = 64;
+
+        // the header in front of the pixels is a multiple of the alignment, so the pixels keep it.
+        const size_t PIXEL_HEADER_SIZE = PIXEL_ALIGNMENT;
+
+        // PIXEL_ALIGNMENT aligned, the byte in front of the block is its distance to the SDL_malloc() one.
+        inline void* pixel_heap_alloc(size_t bytes) {
+            uint8_t* raw = static_cast<uint8_t*>(SDL_malloc(bytes + PIXEL_ALIGNMENT));
+            if (raw == nullptr) {
+                throw SDL2Exception{ "SDL_malloc() failed", "out of memory" };
+            }
+
+            uint8_t* block = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(raw) + PIXEL_ALIGNMENT) & ~(PIXEL_ALIGNMENT - 1));
+            block[-1] = static_cast<uint8_t>(block - raw);
+            return block;
+        }
+
+        inline void pixel_heap_free(void* block) noexcept {
+            uint8_t* aligned = static_cast<uint8_t*>(block);
+            SDL_free(aligned - aligned[-1]);
+        }
+
+        // rows aligned to 16 bytes, like SDL_CreateRGBSurface() on SIMD builds.
+        inline int pixel_pitch(int w, uint32_t format) noexcept {
+            return (w * SDL_BYTESPERPIXEL(format) + 15) & ~15;
+        }
+
+        inline Surface surface_from_pixels(void* pixels, int w, int h, uint32_t format, PixelRelease release, void* context) {
+            SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels, w, h, SDL_BITSPERPIXEL(format), pixel_pitch(w, format), format);
+            if (surface == nullptr) {
+                const char* sdlErrMsg = SDL_GetError();
+                release(pixels, context);
+                throw SDL2Exception{ "SDL_CreateRGBSurfaceWithFormatFrom() failed", sdlErrMsg };
+            }
+
+            return Surface{ surface, release, context };
+        }
+    }
+
+    /*
+        a pool of pixel buffers in power of two size classes (4 KiB to 128 MiB), for the surfaces made and freed every frame.
+        a destroyed Surface gives its buffer back to the pool instead of the heap, up to maxCachedBytes are kept.
+        the pixels are NOT cleared, unlike SDL_CreateRGBSurfaceWithFormat(). thread safe,
+        the pool must outlive its surfaces.
+
+            sdl2::PixelPool pool;
+            sdl2::Surface scratch = pool.create_surface(w, h, SDL_PIXELFORMAT_ARGB8888);
+    */
+    class PixelPool {
+        static const int MIN_CLASS_BITS = 12;
+        static const int CLASS_NUM = 16;
+
+        // stored in the header in front of the pixels.
+        struct Block {
+            int sizeClass;         // -1 for the buffers too big for a class, they go straight back to the heap.
+            size_t capacity;
+        };
+
+        std::array<std::vector<void*>, CLASS_NUM> freeBlocks;
+        size_t maxCachedBytes;
+        std::mutex mutex;
+        PixelAllocStats stats;
+
+        static Block* block_of(void* pixels) noexcept {
+            return reinterpret_cast<Block*>(static_cast<uint8_t*>(pixels) - kernels::PIXEL_HEADER_SIZE);
+        }
+
+        static void release_pixels(void* pixels, void* pool) noexcept {
+            static_cast<PixelPool*>(pool)->release(pixels);
+        }
+    public:
+        PixelPool(size_t _maxCachedBytes = 64 * 1024 * 1024) : freeBlocks{}, maxCachedBytes{ _maxCachedBytes }, mutex{}, stats{} {}
+
+        PixelPool(const PixelPool&) = delete;
+        PixelPool& operator=(const PixelPool&) = delete;
+
+        ~PixelPool() {
+            trim();
+        }
+
+        // a buffer of at least bytes, 64 bytes aligned.
+        void* allocate(size_t bytes) {
+            int sizeClass = 0;
+            while (sizeClass < CLASS_NUM && (static_cast<size_t>(1) << (sizeClass + MIN_CLASS_BITS)) < bytes) {
+                ++sizeClass;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                ++stats.requests;
+                ++stats.liveBuffers;
+                if (sizeClass < CLASS_NUM && !freeBlocks[sizeClass].empty()) {
+                    void* pixels = freeBlocks[sizeClass].back();
+                    freeBlocks[sizeClass].pop_back();
+                    stats.reservedBytes -= block_of(pixels)->capacity;
+                    return pixels;
+                }
+
+                ++stats.heapAllocations;
+            }
+
+            size_t capacity = sizeClass < CLASS_NUM ? static_cast<size_t>(1) << (sizeClass + MIN_CLASS_BITS) : bytes;
+            void* block;
+            try {
+                block = kernels::pixel_heap_alloc(kernels::PIXEL_HEADER_SIZE + capacity);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock{ mutex };
+                --stats.liveBuffers;
+                throw;
+            }
+
+            void* pixels = static_cast<uint8_t*>(block) + kernels::PIXEL_HEADER_SIZE;
+            Block* header = block_of(pixels);
+            header->sizeClass = sizeClass < CLASS_NUM ? sizeClass : -1;
+            header->capacity = capacity;
+            return pixels;
+        }
+
+        void release(void* pixels) noexcept {
+            Block* header = block_of(pixels);
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                --stats.liveBuffers;
+                if (header->sizeClass >= 0 && stats.reservedBytes + header->capacity <= maxCachedBytes) {
+                    // the vector grows only until the pool reached its steady state.
+                    try {
+                        freeBlocks[header->sizeClass].push_back(pixels);
+                        stats.reservedBytes += header->capacity;
+                        return;
+                    }
+                    catch (...) {}
+                }
+            }
+
+            kernels::pixel_heap_free(header);
+        }
+
+        Surface create_surface(int w, int h, uint32_t format) {
+            void* pixels = allocate(static_cast<size_t>(kernels::pixel_pitch(w, format)) * h);
+            return kernels::surface_from_pixels(pixels, w, h, format, release_pixels, this);
+        }
+
+        // gives the cached buffers back to the heap.
+        void trim() noexcept {
+            std::lock_guard<std::mutex> lock{ mutex };
+            for (std::vector<void*>& blocks : freeBlocks) {
+                for (void* pixels : blocks) {
+                    kernels::pixel_heap_free(block_of(pixels));
+                }
+
+                blocks.clear();
+            }
+
+            stats.reservedBytes = 0;
+        }
+
+        PixelAllocStats get_stats() noexcept {
+            std::lock_guard<std::mutex> lock{ mutex };
+            return stats;
+        }
+    };
+
+    /*
+        a bump allocator for the surfaces which only live during one frame, call reset() at the start of each frame
+        once they are all destroyed, it throws while one is alive. when the arena is full the buffers come from the heap
+        (counted in heapAllocations), make the arena bigger until there are none. not thread safe, the pixels are NOT cleared,
+        the arena must outlive its surfaces.
+    */
+    class FrameArena {
+        uint8_t* memory;
+        size_t capacity;
+        size_t used;
+        PixelAllocStats stats;
+
+        static void release_pixels(void* pixels, void* arena) noexcept {
+            FrameArena* self = static_cast<FrameArena*>(arena);
+            --self->stats.liveBuffers;
+            if (pixels < self->memory || pixels >= self->memory + self->capacity) {
+                kernels::pixel_heap_free(static_cast<uint8_t*>(pixels) - kernels::PIXEL_HEADER_SIZE);
+            }
+        }
+    public:
+        FrameArena(size_t _capacity) : memory{ nullptr }, capacity{ _capacity }, used{ 0 }, stats{} {
+            memory = static_cast<uint8_t*>(kernels::pixel_heap_alloc(_capacity));
+        }
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        ~FrameArena() {
+            kernels::pixel_heap_free(memory);
+        }
+
+        // a buffer of at least bytes, 64 bytes aligned.
+        void* allocate(size_t bytes) {
+            ++stats.requests;
+            size_t aligned = (bytes + kernels::PIXEL_ALIGNMENT - 1) & ~(kernels::PIXEL_ALIGNMENT - 1);
+            if (aligned <= capacity - used) {
+                void* pixels = memory + used;
+                used += aligned;
+                ++stats.liveBuffers;
+                stats.reservedBytes = used;
+                return pixels;
+            }
+
+            ++stats.heapAllocations;
+            void* block = kernels::pixel_heap_alloc(kernels::PIXEL_HEADER_SIZE + bytes);
+            ++stats.liveBuffers;
+            return static_cast<uint8_t*>(block) + kernels::PIXEL_HEADER_SIZE;
+        }
+
+        Surface create_surface(int w, int h, uint32_t format) {
+            void* pixels = allocate(static_cast<size_t>(kernels::pixel_pitch(w, format)) * h);
+            return kernels::surface_from_pixels(pixels, w, h, format, release_pixels, this);
+        }
+
+        // every surface of the previous frame must be destroyed, else their pixels would be handed out again.
+        void reset() {
+            if (stats.liveBuffers != 0) {
+                throw SDL2Exception{ "FrameArena::reset() failed", "surfaces of the previous frame are still alive" };
+            }
+
+            used = 0;
+            stats.reservedBytes = 0;
+        }
+
+        size_t get_capacity() const noexcept {
+            return capacity;
+        }
+
+        PixelAllocStats get_stats() const noexcept {
+            return stats;
+        }
+    };
+
+    struct SDLMemoryCounts {
+        uint64_t mallocs;
+        uint64_t callocs;
+        uint64_t reallocs;
+        uint64_t frees;
+    };
+
+    /*
+        counts the SDL_malloc() / SDL_calloc() / SDL_realloc() / SDL_free() calls of SDL and of the libraries
+        built on it (SDL_ttf, SDL_image, SDL_mixer), to check a frame loop reached zero allocations.
+        the counting functions forward to the ones installed before, so it can be created at any time,
+        but only one can exist at once, the constructor of a second one throws.
+
+            sdl2::SDLMemoryCounter counter;
+            run_frame();
+            uint64_t mallocs = sdl2::SDLMemoryCounter::get_counts().mallocs;
+    */
+    class SDLMemoryCounter {
+        struct Functions {
+            SDL_malloc_func mallocFunc;
+            SDL_calloc_func callocFunc;
+            SDL_realloc_func reallocFunc;
+            SDL_free_func freeFunc;
+        };
+
+        static Functions& previous() noexcept {
+            static Functions functions;
+            return functions;
+        }
+
+        static std::atomic<bool>& active() noexcept {
+            static std::atomic<bool> value{ false };
+            return value;
+        }
+
+        static std::array<std::atomic<uint64_t>, 4>& counts() noexcept {
+            static std::array<std::atomic<uint64_t>, 4> values;
+            return values;
+        }
+
+        static void* SDLCALL counting_malloc(size_t size) {
+            counts()[0].fetch_add(1, std::memory_order_relaxed);
+            return previous().mallocFunc(size);
+        }
+
+        static void* SDLCALL counting_calloc(size_t nmemb, size_t size) {
+            counts()[1].fetch_add(1, std::memory_order_relaxed);
+            return previous().callocFunc(nmemb, size);
+        }
+
+        static void* SDLCALL counting_realloc(void* mem, size_t size) {
+            counts()[2].fetch_add(1, std::memory_order_relaxed);
+            return previous().reallocFunc(mem, size);
+        }
+
+        static void SDLCALL counting_free(void* mem) {
+            counts()[3].fetch_add(1, std::memory_order_relaxed);
+            previous().freeFunc(mem);
+        }
+    public:
+        SDLMemoryCounter() {
+            // a second counter would save the first one's functions, then forward to itself.
+            if (active().exchange(true)) {
+                throw SDL2Exception{ "SDLMemoryCounter() failed", "another SDLMemoryCounter exists" };
+            }
+
+            Functions& functions = previous();
+            SDL_GetMemoryFunctions(&functions.mallocFunc, &functions.callocFunc, &functions.reallocFunc, &functions.freeFunc);
+            reset_counts();
+
+            if (SDL_SetMemoryFunctions(counting_malloc, counting_calloc, counting_realloc, counting_free) < 0) {
+                const char* sdlErrMsg = SDL_GetError();
+                active().store(false);
+                throw SDL2Exception{ "SDL_SetMemoryFunctions() failed", sdlErrMsg };
+            }
+        }
+
+        SDLMemoryCounter(const SDLMemoryCounter&) = delete;
+        SDLMemoryCounter& operator=(const SDLMemoryCounter&) = delete;
+
+        ~SDLMemoryCounter() {
+            Functions& functions = previous();
+            SDL_SetMemoryFunctions(functions.mallocFunc, functions.callocFunc, functions.reallocFunc, functions.freeFunc);
+            active().store(false);
+        }
+
+        static SDLMemoryCounts get_counts() noexcept {
+            return SDLMemoryCounts{ counts()[0].load(), counts()[1].load(), counts()[2].load(), counts()[3].load() };
+        }
+
+        static void reset_counts() noexcept {
+            for (std::atomic<uint64_t>& count : counts()) {
+                count.store(0);
+            }
+        }
+    };
+
     class Texture {
         SDL_Texture* texture;
     public:
@@ -297,336 +1037,5855 @@ namespace sdl2 {
         }
     };
 
-    void sdl_fill_rect(SDL_Surface * dst, const SDL_Rect* rect, uint32_t color) {
-        if (SDL_FillRect(dst, rect, color) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_FillRect() failed", sdlErrMsg };
-        }
-    }
+    // a TimerWheel timer, {0, 0} is never a live timer.
+    struct TimerHandle {
+        uint32_t index;
+        uint32_t generation;
+    };
 
     /*
-        You must never destroy the returned surface, according to the SDL2 document.
-        and you can't set the returned surface to Surface.
+        a hierarchical timing wheel (4 levels of 256 slots, 1 ms ticks, up to 49 days), advanced by the owning thread,
+        so the callbacks run there instead of on SDL's timer thread. add() and cancel() are O(1).
+        the callbacks have the SDL_TimerCallback signature and meaning: the returned value is the next interval, 0 stops the timer.
+        a callback may add or cancel any timer, itself included.
+
+            sdl2::TimerWheel timers;
+            sdl2::TimerHandle blink = timers.add(500, blink_callback, &cursor);
+            while (running) {
+                timers.update();
+                ...
+            }
     */
-    SDL_Surface* sdl_window_get_surface(Window& window) noexcept {
-        return SDL_GetWindowSurface(window.get());
-    }
+    class TimerWheel {
+        static const int SLOT_BITS = 8;
+        static const uint32_t SLOT_NUM = 1u << SLOT_BITS;
+        static const uint32_t SLOT_MASK = SLOT_NUM - 1;
+        static const int LEVEL_NUM = 4;
+        static const uint32_t NONE = UINT32_MAX;
 
-    void sdl_update_window_surface(Window& window) {
-        if (SDL_UpdateWindowSurface(window.get()) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_UpdateWindowSurface() failed", sdlErrMsg };
-        }
-    }
+        enum class State : uint8_t {
+            FREE, WAITING, FIRING
+        };
 
-    void sdl_blit_surface(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, SDL_Rect* dstRect) {
-        if (SDL_BlitSurface(src, srcRect, dst, dstRect) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_BlitSurface() failed", sdlErrMsg };
-        }
-    }
+        struct Node {
+            uint64_t expires;
+            SDL_TimerCallback callback;
+            void* param;
+            uint32_t interval;
+            uint32_t generation;
+            uint32_t prev;
+            uint32_t next;
+            uint32_t* list;
+            State state;
+        };
 
-    void sdl_set_render_draw_color(Renderer& renderer, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-        if (SDL_SetRenderDrawColor(renderer.get(), r, g, b, a) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_SetRenderDrawColor() failed", sdlErrMsg };
-        }
-    }
+        std::vector<Node> nodes;
+        std::array<uint32_t, LEVEL_NUM * SLOT_NUM> slots;
+        uint32_t freeList;
+        size_t activeNum;
+        uint64_t currentTick;
+        uint32_t lastTicks;
 
-    void sdl_render_clear(Renderer& renderer) {
-        if (SDL_RenderClear(renderer.get()) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderClear() failed", sdlErrMsg };
+        void link(uint32_t index) noexcept {
+            Node& node = nodes[index];
+            uint64_t delta = node.expires - currentTick;
+            int level = 0;
+            while (level < LEVEL_NUM - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) {
+                ++level;
+            }
+
+            uint32_t* list = &slots[level * SLOT_NUM + ((node.expires >> (SLOT_BITS * level)) & SLOT_MASK)];
+            node.list = list;
+            node.prev = NONE;
+            node.next = *list;
+            if (*list != NONE) {
+                nodes[*list].prev = index;
+            }
+
+            *list = index;
+        }
+
+        void unlink(uint32_t index) noexcept {
+            Node& node = nodes[index];
+            if (node.prev != NONE) {
+                nodes[node.prev].next = node.next;
+            }
+            else {
+                *node.list = node.next;
+            }
+
+            if (node.next != NONE) {
+                nodes[node.next].prev = node.prev;
+            }
+
+            node.list = nullptr;
+        }
+
+        void release(uint32_t index) noexcept {
+            Node& node = nodes[index];
+            node.state = State::FREE;
+            ++node.generation;
+            node.next = freeList;
+            freeList = index;
+            --activeNum;
+        }
+
+        // moves the timers of a higher level slot down, now that they are closer.
+        void cascade(int level, uint32_t slot) noexcept {
+            uint32_t index = slots[level * SLOT_NUM + slot];
+            slots[level * SLOT_NUM + slot] = NONE;
+            while (index != NONE) {
+                uint32_t next = nodes[index].next;
+                link(index);
+                index = next;
+            }
+        }
+
+        void tick() {
+            uint32_t slot = static_cast<uint32_t>(currentTick & SLOT_MASK);
+            for (int level = 1; slot == 0 && level < LEVEL_NUM; ++level) {
+                slot = static_cast<uint32_t>((currentTick >> (SLOT_BITS * level)) & SLOT_MASK);
+                cascade(level, slot);
+            }
+
+            // the callbacks can add and cancel timers, so no reference into nodes is kept across them.
+            uint32_t* due = &slots[currentTick & SLOT_MASK];
+            while (*due != NONE) {
+                uint32_t index = *due;
+                unlink(index);
+                nodes[index].state = State::FIRING;
+                uint32_t generation = nodes[index].generation;
+
+                uint32_t interval = nodes[index].callback(nodes[index].interval, nodes[index].param);
+
+                Node& node = nodes[index];
+                if (node.generation != generation || node.state != State::FIRING) {
+                    continue;
+                }
+
+                if (interval == 0) {
+                    release(index);
+                }
+                else {
+                    node.interval = interval;
+                    node.expires = currentTick + interval;
+                    node.state = State::WAITING;
+                    link(index);
+                }
+            }
+        }
+    public:
+        TimerWheel() : nodes{}, slots{}, freeList{ NONE }, activeNum{ 0 }, currentTick{ 0 }, lastTicks{ SDL_GetTicks() } {
+            slots.fill(uint32_t{ NONE });
+        }
+
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        ~TimerWheel() {}
+
+        // fires interval milliseconds from now, an interval of 0 fires on the next tick.
+        TimerHandle add(uint32_t interval, SDL_TimerCallback callback, void* param) {
+            uint32_t index = freeList;
+            if (index != NONE) {
+                freeList = nodes[index].next;
+            }
+            else {
+                index = static_cast<uint32_t>(nodes.size());
+                nodes.push_back(Node{ 0, nullptr, nullptr, 0, 1, NONE, NONE, nullptr, State::FREE });
+            }
+
+            Node& node = nodes[index];
+            node.expires = currentTick + std::max<uint32_t>(interval, 1);
+            node.callback = callback;
+            node.param = param;
+            node.interval = interval;
+            node.state = State::WAITING;
+            link(index);
+            ++activeNum;
+
+            return TimerHandle{ index, node.generation };
+        }
+
+        // returns false if the timer already stopped.
+        bool cancel(TimerHandle handle) noexcept {
+            if (!active(handle)) {
+                return false;
+            }
+
+            if (nodes[handle.index].state == State::WAITING) {
+                unlink(handle.index);
+            }
+
+            release(handle.index);
+            return true;
+        }
+
+        bool active(TimerHandle handle) const noexcept {
+            return handle.index < nodes.size() && nodes[handle.index].generation == handle.generation && nodes[handle.index].state != State::FREE;
+        }
+
+        // advances by the SDL_GetTicks() time passed since the last update().
+        void update() {
+            uint32_t now = SDL_GetTicks();
+            uint32_t elapsed = now - lastTicks;
+            lastTicks = now;
+            advance(elapsed);
+        }
+
+        // advances by milliSeconds and fires the due timers, in expiry order.
+        void advance(uint32_t milliSeconds) {
+            uint64_t target = currentTick + milliSeconds;
+            while (currentTick < target) {
+                ++currentTick;
+                tick();
+            }
+        }
+
+        void clear() noexcept {
+            for (uint32_t i = 0; i < nodes.size(); ++i) {
+                if (nodes[i].state != State::FREE) {
+                    if (nodes[i].state == State::WAITING) {
+                        unlink(i);
+                    }
+
+                    release(i);
+                }
+            }
+        }
+
+        size_t size() const noexcept {
+            return activeNum;
+        }
+
+        // the milliseconds advanced since the wheel was created.
+        uint64_t now() const noexcept {
+            return currentTick;
+        }
+    };
+
+    struct FrameStats {
+        double minMilliSeconds;
+        double avgMilliSeconds;
+        double p99MilliSeconds;
+        double maxMilliSeconds;
+        uint64_t frames;
+        uint64_t missedDeadlines;
+    };
+
+    /*
+        paces the frame loop with SDL_GetPerformanceCounter(): sleeps with SDL_Delay() until spinMilliSeconds
+        before the deadline, then spins, because SDL_Delay() may oversleep by a few milliseconds.
+        with vsync the present already blocks, so wait() only measures.
+
+        optional fixed simulation timestep:
+
+            pacer.set_fixed_step(120);
+            while (running) {
+                while (pacer.step()) {
+                    update(pacer.step_seconds());
+                }
+
+                render(pacer.alpha());    // interpolate between the last 2 simulation states.
+                sdl2::sdl_render_present(renderer);
+                pacer.wait();
+            }
+    */
+    class FramePacer {
+        uint64_t frequency;
+        uint64_t frameTicks;
+        uint64_t spinTicks;
+        uint64_t lastFrame;
+        uint64_t deadline;
+        uint64_t frameDelta;
+        bool vsync;
+
+        uint64_t stepTicks;
+        uint64_t accumulator;
+
+        std::vector<double> samples;
+        size_t sampleNum;
+        size_t sampleIndex;
+        uint64_t frames;
+        uint64_t missed;
+
+        double to_milli_seconds(uint64_t ticks) const noexcept {
+            return ticks * 1000.0 / frequency;
+        }
+
+        void record(uint64_t ticks) {
+            double ms = to_milli_seconds(ticks);
+            if (samples.size() < sampleNum) {
+                samples.push_back(ms);
+            }
+            else {
+                samples[sampleIndex] = ms;
+                sampleIndex = (sampleIndex + 1) % sampleNum;
+            }
+
+            ++frames;
+        }
+    public:
+        FramePacer(double frameRate, bool _vsync = false, double spinMilliSeconds = 2.0, size_t _sampleNum = 240)
+            : frequency{ SDL_GetPerformanceFrequency() },
+              frameTicks{ static_cast<uint64_t>(frequency / frameRate) },
+              spinTicks{ static_cast<uint64_t>(frequency * spinMilliSeconds / 1000.0) },
+              lastFrame{ SDL_GetPerformanceCounter() },
+              deadline{ lastFrame + frameTicks },
+              frameDelta{ frameTicks },
+              vsync{ _vsync },
+              stepTicks{ 0 },
+              accumulator{ 0 },
+              samples{},
+              sampleNum{ std::max<size_t>(_sampleNum, 1) },
+              sampleIndex{ 0 },
+              frames{ 0 },
+              missed{ 0 }
+        {
+            samples.reserve(sampleNum);
+        }
+
+        // call it once per frame, after sdl_render_present() or sdl_update_window_surface().
+        void wait() {
+            uint64_t now = SDL_GetPerformanceCounter();
+
+            if (vsync) {
+                // more than one and a half refresh means a refresh was missed.
+                if (now - lastFrame > frameTicks + frameTicks / 2) {
+                    ++missed;
+                }
+            }
+            else if (now > deadline) {
+                ++missed;
+
+                // too late to catch up, start over from now instead of rushing the next frames.
+                if (now - deadline > frameTicks) {
+                    deadline = now;
+                }
+            }
+            else {
+                uint64_t remaining = deadline - now;
+                if (remaining > spinTicks) {
+                    SDL_Delay(static_cast<uint32_t>((remaining - spinTicks) * 1000 / frequency));
+                }
+
+                while ((now = SDL_GetPerformanceCounter()) < deadline) {}
+            }
+
+            frameDelta = now - lastFrame;
+            lastFrame = now;
+            deadline += frameTicks;
+            record(frameDelta);
+
+            if (stepTicks > 0) {
+                // never simulate more than a quarter second per frame, after a breakpoint or a hitch.
+                accumulator = std::min(accumulator + frameDelta, frequency / 4 + stepTicks);
+            }
+        }
+
+        void set_fixed_step(double stepsPerSecond) noexcept {
+            stepTicks = static_cast<uint64_t>(frequency / stepsPerSecond);
+            accumulator = 0;
+        }
+
+        // returns true while a fixed simulation step is due.
+        bool step() noexcept {
+            if (stepTicks == 0 || accumulator < stepTicks) {
+                return false;
+            }
+
+            accumulator -= stepTicks;
+            return true;
+        }
+
+        double step_seconds() const noexcept {
+            return static_cast<double>(stepTicks) / frequency;
+        }
+
+        // how far the frame is between the last and the next simulation step, in [0, 1).
+        double alpha() const noexcept {
+            return stepTicks == 0 ? 0.0 : static_cast<double>(accumulator) / stepTicks;
+        }
+
+        // the length of the last frame.
+        double delta_seconds() const noexcept {
+            return static_cast<double>(frameDelta) / frequency;
+        }
+
+        // min / avg / p99 / max over the last sampleNum frames.
+        FrameStats stats() const {
+            FrameStats result = { 0, 0, 0, 0, frames, missed };
+            if (samples.empty()) {
+                return result;
+            }
+
+            std::vector<double> sorted{ samples };
+            std::sort(sorted.begin(), sorted.end());
+
+            double sum = 0;
+            for (double ms : sorted) {
+                sum += ms;
+            }
+
+            result.minMilliSeconds = sorted.front();
+            result.avgMilliSeconds = sum / sorted.size();
+            result.p99MilliSeconds = sorted[(sorted.size() - 1) * 99 / 100];
+            result.maxMilliSeconds = sorted.back();
+            return result;
+        }
+
+        void reset_stats() noexcept {
+            samples.clear();
+            sampleIndex = 0;
+            frames = 0;
+            missed = 0;
+        }
+    };
+
+    /*
+        the CRTP base of an event handler, derive from it and hide the on_*() functions you need:
+
+            struct Game : sdl2::EventHandler<Game> {
+                bool running = true;
+                void on_quit(const SDL_QuitEvent&, uint64_t) { running = false; }
+                void on_key_down(const SDL_KeyboardEvent& e, uint64_t inputTime) { ... }
+            };
+
+        the calls are resolved at compile time, no virtual call, no std::function, no allocation.
+        inputTime is the SDL_GetPerformanceCounter() value when the events were pumped,
+        e.g. EventDispatcher::milliseconds_since(inputTime) right after sdl_render_present() is the input to present latency.
+    */
+    template <typename Derived>
+    class EventHandler {
+    public:
+        void on_quit(const SDL_QuitEvent&, uint64_t) {}
+        void on_window(const SDL_WindowEvent&, uint64_t) {}
+        void on_key_down(const SDL_KeyboardEvent&, uint64_t) {}
+        void on_key_up(const SDL_KeyboardEvent&, uint64_t) {}
+        void on_text_input(const SDL_TextInputEvent&, uint64_t) {}
+        void on_mouse_motion(const SDL_MouseMotionEvent&, uint64_t) {}
+        void on_mouse_button_down(const SDL_MouseButtonEvent&, uint64_t) {}
+        void on_mouse_button_up(const SDL_MouseButtonEvent&, uint64_t) {}
+        void on_mouse_wheel(const SDL_MouseWheelEvent&, uint64_t) {}
+        void on_controller_axis(const SDL_ControllerAxisEvent&, uint64_t) {}
+        void on_controller_button_down(const SDL_ControllerButtonEvent&, uint64_t) {}
+        void on_controller_button_up(const SDL_ControllerButtonEvent&, uint64_t) {}
+        void on_finger_down(const SDL_TouchFingerEvent&, uint64_t) {}
+        void on_finger_up(const SDL_TouchFingerEvent&, uint64_t) {}
+        void on_finger_motion(const SDL_TouchFingerEvent&, uint64_t) {}
+        void on_user(const SDL_UserEvent&, uint64_t) {}
+
+        // every other event type.
+        void on_event(const SDL_Event&, uint64_t) {}
+
+        void dispatch(const SDL_Event& event, uint64_t inputTime) {
+            Derived& self = static_cast<Derived&>(*this);
+            switch (event.type) {
+            case SDL_QUIT:                  self.on_quit(event.quit, inputTime); break;
+            case SDL_WINDOWEVENT:           self.on_window(event.window, inputTime); break;
+            case SDL_KEYDOWN:               self.on_key_down(event.key, inputTime); break;
+            case SDL_KEYUP:                 self.on_key_up(event.key, inputTime); break;
+            case SDL_TEXTINPUT:             self.on_text_input(event.text, inputTime); break;
+            case SDL_MOUSEMOTION:           self.on_mouse_motion(event.motion, inputTime); break;
+            case SDL_MOUSEBUTTONDOWN:       self.on_mouse_button_down(event.button, inputTime); break;
+            case SDL_MOUSEBUTTONUP:         self.on_mouse_button_up(event.button, inputTime); break;
+            case SDL_MOUSEWHEEL:            self.on_mouse_wheel(event.wheel, inputTime); break;
+            case SDL_CONTROLLERAXISMOTION:  self.on_controller_axis(event.caxis, inputTime); break;
+            case SDL_CONTROLLERBUTTONDOWN:  self.on_controller_button_down(event.cbutton, inputTime); break;
+            case SDL_CONTROLLERBUTTONUP:    self.on_controller_button_up(event.cbutton, inputTime); break;
+            case SDL_FINGERDOWN:            self.on_finger_down(event.tfinger, inputTime); break;
+            case SDL_FINGERUP:              self.on_finger_up(event.tfinger, inputTime); break;
+            case SDL_FINGERMOTION:          self.on_finger_motion(event.tfinger, inputTime); break;
+            default:
+                if (event.type >= SDL_USEREVENT && event.type < SDL_LASTEVENT) {
+                    self.on_user(event.user, inputTime);
+                }
+                else {
+                    self.on_event(event, inputTime);
+                }
+                break;
+            }
+        }
+    };
+
+    /*
+        drains the SDL event queue in batches with SDL_PeepEvents() into a fixed buffer,
+        and dispatches them to an EventHandler, call poll() once per frame instead of a SDL_PollEvent() loop.
+    */
+    class EventDispatcher {
+        static const int BATCH_SIZE = 64;
+
+        std::array<SDL_Event, BATCH_SIZE> batch;
+        uint64_t lastInputTime;
+    public:
+        EventDispatcher() : batch{}, lastInputTime{ 0 } {}
+
+        EventDispatcher(const EventDispatcher&) = delete;
+        EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+        ~EventDispatcher() {}
+
+        // returns the number of dispatched events.
+        template <typename Handler>
+        size_t poll(Handler& handler) {
+            SDL_PumpEvents();
+            lastInputTime = SDL_GetPerformanceCounter();
+
+            size_t total = 0;
+            while (true) {
+                int n = SDL_PeepEvents(batch.data(), BATCH_SIZE, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+                if (n <= 0) {
+                    break;
+                }
+
+                for (int i = 0; i < n; ++i) {
+                    handler.dispatch(batch[i], lastInputTime);
+                }
+
+                total += static_cast<size_t>(n);
+                if (n < BATCH_SIZE) {
+                    break;
+                }
+            }
+
+            return total;
+        }
+
+        // the performance counter value of the last poll().
+        uint64_t last_input_time() const noexcept {
+            return lastInputTime;
+        }
+
+        static double milliseconds_since(uint64_t inputTime) noexcept {
+            return static_cast<double>(SDL_GetPerformanceCounter() - inputTime) * 1000.0 / SDL_GetPerformanceFrequency();
+        }
+    };
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_fill_rect(SDL_Surface * dst, const SDL_Rect* rect, uint32_t color) {
+        SDL2_PROFILE_SCOPE("sdl_fill_rect");
+        return ErrorPolicy::check(SDL_FillRect(dst, rect, color), "SDL_FillRect() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_fill_rects(SDL_Surface* dst, const SDL_Rect* rects, int count, uint32_t color) {
+        SDL2_PROFILE_SCOPE("sdl_fill_rects");
+        return ErrorPolicy::check(SDL_FillRects(dst, rects, count, color), "SDL_FillRects() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_fill_rects(SDL_Surface* dst, const std::vector<SDL_Rect>& rects, uint32_t color) {
+        return sdl_fill_rects<ErrorPolicy>(dst, rects.data(), static_cast<int>(rects.size()), color);
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_fill_rects(SDL_Surface* dst, const std::array<SDL_Rect, N>& rects, uint32_t color) {
+        return sdl_fill_rects<ErrorPolicy>(dst, rects.data(), static_cast<int>(N), color);
+    }
+
+    /*
+        You must never destroy the returned surface, according to the SDL2 document.
+        and you can't set the returned surface to Surface.
+    */
+    SDL_Surface* sdl_window_get_surface(Window& window) noexcept {
+        return SDL_GetWindowSurface(window.get());
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_update_window_surface(Window& window) {
+        SDL2_PROFILE_SCOPE("sdl_update_window_surface");
+        SDL2_PROFILE_FRAME();
+        return ErrorPolicy::check(SDL_UpdateWindowSurface(window.get()), "SDL_UpdateWindowSurface() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_blit_surface(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, SDL_Rect* dstRect) {
+        SDL2_PROFILE_SCOPE("sdl_blit_surface");
+        return ErrorPolicy::check(SDL_BlitSurface(src, srcRect, dst, dstRect), "SDL_BlitSurface() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_update_window_surface_rects(Window& window, const SDL_Rect* rects, int rectNum) {
+        SDL2_PROFILE_SCOPE("sdl_update_window_surface_rects");
+        SDL2_PROFILE_FRAME();
+        return ErrorPolicy::check(SDL_UpdateWindowSurfaceRects(window.get(), rects, rectNum), "SDL_UpdateWindowSurfaceRects() failed");
+    }
+
+    struct DamageStats {
+        uint64_t presents;
+        uint64_t fullUpdates;
+        uint64_t partialUpdates;
+        uint64_t pixelsUpdated;
+    };
+
+    /*
+        collects the changed rects of the window surface, so present() only pushes them with SDL_UpdateWindowSurfaceRects().
+        overlapping rects are merged, and when more than maxRects are left, the 2 closest ones are merged into their bounding box.
+        if the damaged area covers more than fullThreshold of the surface, present() updates the whole window instead.
+        the sdl_fill_rect() and sdl_blit_surface() overloads taking a DamageTracker record their rects by themselves,
+        call add() after drawing into surface() any other way.
+    */
+    class DamageTracker {
+        Window& window;
+        std::vector<SDL_Rect> rects;
+        double fullThreshold;
+        size_t maxRects;
+        bool full;
+        DamageStats stats;
+
+        static int64_t area(const SDL_Rect& r) noexcept {
+            return static_cast<int64_t>(r.w) * r.h;
+        }
+
+        static SDL_Rect bounds(const SDL_Rect& a, const SDL_Rect& b) noexcept {
+            SDL_Rect r;
+            r.x = std::min(a.x, b.x);
+            r.y = std::min(a.y, b.y);
+            r.w = std::max(a.x + a.w, b.x + b.w) - r.x;
+            r.h = std::max(a.y + a.h, b.y + b.h) - r.y;
+            return r;
+        }
+
+        // merges the rects that overlap rects[index], until none of them does.
+        void merge_overlaps(size_t index) {
+            bool merged = true;
+            while (merged) {
+                merged = false;
+                for (size_t i = 0; i < rects.size(); ++i) {
+                    if (i != index && SDL_HasIntersection(&rects[i], &rects[index])) {
+                        rects[index] = bounds(rects[index], rects[i]);
+                        rects[i] = rects.back();
+                        rects.pop_back();
+                        if (index == rects.size()) {
+                            index = i;
+                        }
+
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // merges the pair of rects whose bounding box wastes the least area.
+        void merge_closest() {
+            size_t bestA = 0;
+            size_t bestB = 1;
+            int64_t bestWaste = INT64_MAX;
+            for (size_t a = 0; a < rects.size(); ++a) {
+                for (size_t b = a + 1; b < rects.size(); ++b) {
+                    int64_t waste = area(bounds(rects[a], rects[b])) - area(rects[a]) - area(rects[b]);
+                    if (waste < bestWaste) {
+                        bestWaste = waste;
+                        bestA = a;
+                        bestB = b;
+                    }
+                }
+            }
+
+            rects[bestA] = bounds(rects[bestA], rects[bestB]);
+            rects[bestB] = rects.back();
+            rects.pop_back();
+            merge_overlaps(bestA);
+        }
+    public:
+        DamageTracker(Window& _window, double _fullThreshold = 0.5, size_t _maxRects = 32)
+            : window{ _window }, rects{}, fullThreshold{ _fullThreshold }, maxRects{ std::max<size_t>(_maxRects, 1) }, full{ false }, stats{} {
+            rects.reserve(maxRects + 1);
+        }
+
+        DamageTracker(const DamageTracker&) = delete;
+        DamageTracker& operator=(const DamageTracker&) = delete;
+
+        ~DamageTracker() {}
+
+        // the window surface, it changes after the window is resized.
+        SDL_Surface* surface() noexcept {
+            return sdl_window_get_surface(window);
+        }
+
+        // a null rect damages the whole surface.
+        void add(const SDL_Rect* rect) {
+            if (full) {
+                return;
+            }
+
+            SDL_Surface* windowSurface = surface();
+            if (rect == nullptr || windowSurface == nullptr) {
+                add_all();
+                return;
+            }
+
+            SDL_Rect whole = { 0, 0, windowSurface->w, windowSurface->h };
+            SDL_Rect clipped;
+            if (!SDL_IntersectRect(rect, &whole, &clipped)) {
+                return;
+            }
+
+            rects.push_back(clipped);
+            merge_overlaps(rects.size() - 1);
+            while (rects.size() > maxRects) {
+                merge_closest();
+            }
+        }
+
+        void add_all() noexcept {
+            full = true;
+            rects.clear();
+        }
+
+        const std::vector<SDL_Rect>& get_rects() const noexcept {
+            return rects;
+        }
+
+        // the damaged part of the surface, 0 to 1.
+        double coverage() noexcept {
+            SDL_Surface* windowSurface = surface();
+            if (full || windowSurface == nullptr) {
+                return 1.0;
+            }
+
+            int64_t damaged = 0;
+            for (const SDL_Rect& r : rects) {
+                damaged += area(r);
+            }
+
+            return static_cast<double>(damaged) / std::max<int64_t>(1, static_cast<int64_t>(windowSurface->w) * windowSurface->h);
+        }
+
+        // pushes the damaged rects to the window, or nothing when nothing changed.
+        template <typename ErrorPolicy = ThrowOnError>
+        typename ErrorPolicy::result_type present() {
+            if (!full && rects.empty()) {
+                return ErrorPolicy::check(0, "");
+            }
+
+            SDL_Surface* windowSurface = surface();
+            ++stats.presents;
+
+            if (full || coverage() > fullThreshold) {
+                ++stats.fullUpdates;
+                stats.pixelsUpdated += windowSurface ? static_cast<uint64_t>(windowSurface->w) * windowSurface->h : 0;
+                full = false;
+                rects.clear();
+                return sdl_update_window_surface<ErrorPolicy>(window);
+            }
+
+            ++stats.partialUpdates;
+            for (const SDL_Rect& r : rects) {
+                stats.pixelsUpdated += static_cast<uint64_t>(area(r));
+            }
+
+            std::vector<SDL_Rect> pushed;
+            pushed.swap(rects);
+            rects.reserve(maxRects + 1);
+            return sdl_update_window_surface_rects<ErrorPolicy>(window, pushed.data(), static_cast<int>(pushed.size()));
+        }
+
+        const DamageStats& get_stats() const noexcept {
+            return stats;
+        }
+
+        void reset_stats() noexcept {
+            stats = DamageStats{};
+        }
+    };
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_fill_rect(DamageTracker& damage, const SDL_Rect* rect, uint32_t color) {
+        damage.add(rect);
+        return sdl_fill_rect<ErrorPolicy>(damage.surface(), rect, color);
+    }
+
+    // the damaged rect is the destination rect before clipping, add() clips it to the surface.
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_blit_surface(SDL_Surface* src, const SDL_Rect* srcRect, DamageTracker& damage, SDL_Rect* dstRect) {
+        SDL_Rect rect = { dstRect ? dstRect->x : 0, dstRect ? dstRect->y : 0, srcRect ? srcRect->w : src->w, srcRect ? srcRect->h : src->h };
+        damage.add(&rect);
+        return sdl_blit_surface<ErrorPolicy>(src, srcRect, damage.surface(), dstRect);
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_set_render_draw_color(Renderer& renderer, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+        return ErrorPolicy::check(SDL_SetRenderDrawColor(renderer.get(), r, g, b, a), "SDL_SetRenderDrawColor() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_clear(Renderer& renderer) {
+        SDL2_PROFILE_SCOPE("sdl_render_clear");
+        return ErrorPolicy::check(SDL_RenderClear(renderer.get()), "SDL_RenderClear() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_set_render_draw_blend_mode(Renderer& renderer, SDL_BlendMode blendMode) {
+        return ErrorPolicy::check(SDL_SetRenderDrawBlendMode(renderer.get(), blendMode), "SDL_SetRenderDrawBlendMode() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_fill_rect(Renderer& renderer, const SDL_Rect* rect) {
+        SDL2_PROFILE_SCOPE("sdl_render_fill_rect");
+        return ErrorPolicy::check(SDL_RenderFillRect(renderer.get(), rect), "SDL_RenderFillRect() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_rect(Renderer& renderer, const SDL_Rect* rect) {
+        SDL2_PROFILE_SCOPE("sdl_render_draw_rect");
+        return ErrorPolicy::check(SDL_RenderDrawRect(renderer.get(), rect), "SDL_RenderDrawRect() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_line(Renderer& renderer, int x1, int y1, int x2, int y2) {
+        SDL2_PROFILE_SCOPE("sdl_render_draw_line");
+        return ErrorPolicy::check(SDL_RenderDrawLine(renderer.get(), x1, y1, x2, y2), "SDL_RenderDrawLine() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_lines(Renderer& renderer, const SDL_Point* points, int pointNum) {
+        SDL2_PROFILE_SCOPE("sdl_render_draw_lines");
+        return ErrorPolicy::check(SDL_RenderDrawLines(renderer.get(), points, pointNum), "SDL_RenderDrawLines() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_lines(Renderer& renderer, const std::vector<SDL_Point>& points) {
+        return sdl_render_draw_lines<ErrorPolicy>(renderer, points.data(), static_cast<int>(points.size()));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_render_draw_lines(Renderer& renderer, const std::array<SDL_Point, N>& points) {
+        return sdl_render_draw_lines<ErrorPolicy>(renderer, points.data(), static_cast<int>(N));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_fill_rects(Renderer& renderer, const SDL_Rect* rects, int count) {
+        SDL2_PROFILE_SCOPE("sdl_render_fill_rects");
+        return ErrorPolicy::check(SDL_RenderFillRects(renderer.get(), rects, count), "SDL_RenderFillRects() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_fill_rects(Renderer& renderer, const std::vector<SDL_Rect>& rects) {
+        return sdl_render_fill_rects<ErrorPolicy>(renderer, rects.data(), static_cast<int>(rects.size()));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_render_fill_rects(Renderer& renderer, const std::array<SDL_Rect, N>& rects) {
+        return sdl_render_fill_rects<ErrorPolicy>(renderer, rects.data(), static_cast<int>(N));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_rects(Renderer& renderer, const SDL_Rect* rects, int count) {
+        SDL2_PROFILE_SCOPE("sdl_render_draw_rects");
+        return ErrorPolicy::check(SDL_RenderDrawRects(renderer.get(), rects, count), "SDL_RenderDrawRects() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_rects(Renderer& renderer, const std::vector<SDL_Rect>& rects) {
+        return sdl_render_draw_rects<ErrorPolicy>(renderer, rects.data(), static_cast<int>(rects.size()));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_render_draw_rects(Renderer& renderer, const std::array<SDL_Rect, N>& rects) {
+        return sdl_render_draw_rects<ErrorPolicy>(renderer, rects.data(), static_cast<int>(N));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_points(Renderer& renderer, const SDL_Point* points, int count) {
+        SDL2_PROFILE_SCOPE("sdl_render_draw_points");
+        return ErrorPolicy::check(SDL_RenderDrawPoints(renderer.get(), points, count), "SDL_RenderDrawPoints() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_points(Renderer& renderer, const std::vector<SDL_Point>& points) {
+        return sdl_render_draw_points<ErrorPolicy>(renderer, points.data(), static_cast<int>(points.size()));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_render_draw_points(Renderer& renderer, const std::array<SDL_Point, N>& points) {
+        return sdl_render_draw_points<ErrorPolicy>(renderer, points.data(), static_cast<int>(N));
+    }
+
+    // the float variants need SDL 2.0.10 or later.
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_fill_rects_f(Renderer& renderer, const SDL_FRect* rects, int count) {
+        SDL2_PROFILE_SCOPE("sdl_render_fill_rects_f");
+        return ErrorPolicy::check(SDL_RenderFillRectsF(renderer.get(), rects, count), "SDL_RenderFillRectsF() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_fill_rects_f(Renderer& renderer, const std::vector<SDL_FRect>& rects) {
+        return sdl_render_fill_rects_f<ErrorPolicy>(renderer, rects.data(), static_cast<int>(rects.size()));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_render_fill_rects_f(Renderer& renderer, const std::array<SDL_FRect, N>& rects) {
+        return sdl_render_fill_rects_f<ErrorPolicy>(renderer, rects.data(), static_cast<int>(N));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_rects_f(Renderer& renderer, const SDL_FRect* rects, int count) {
+        SDL2_PROFILE_SCOPE("sdl_render_draw_rects_f");
+        return ErrorPolicy::check(SDL_RenderDrawRectsF(renderer.get(), rects, count), "SDL_RenderDrawRectsF() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_rects_f(Renderer& renderer, const std::vector<SDL_FRect>& rects) {
+        return sdl_render_draw_rects_f<ErrorPolicy>(renderer, rects.data(), static_cast<int>(rects.size()));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_render_draw_rects_f(Renderer& renderer, const std::array<SDL_FRect, N>& rects) {
+        return sdl_render_draw_rects_f<ErrorPolicy>(renderer, rects.data(), static_cast<int>(N));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_points_f(Renderer& renderer, const SDL_FPoint* points, int count) {
+        SDL2_PROFILE_SCOPE("sdl_render_draw_points_f");
+        return ErrorPolicy::check(SDL_RenderDrawPointsF(renderer.get(), points, count), "SDL_RenderDrawPointsF() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_points_f(Renderer& renderer, const std::vector<SDL_FPoint>& points) {
+        return sdl_render_draw_points_f<ErrorPolicy>(renderer, points.data(), static_cast<int>(points.size()));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_render_draw_points_f(Renderer& renderer, const std::array<SDL_FPoint, N>& points) {
+        return sdl_render_draw_points_f<ErrorPolicy>(renderer, points.data(), static_cast<int>(N));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_lines_f(Renderer& renderer, const SDL_FPoint* points, int count) {
+        SDL2_PROFILE_SCOPE("sdl_render_draw_lines_f");
+        return ErrorPolicy::check(SDL_RenderDrawLinesF(renderer.get(), points, count), "SDL_RenderDrawLinesF() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_draw_lines_f(Renderer& renderer, const std::vector<SDL_FPoint>& points) {
+        return sdl_render_draw_lines_f<ErrorPolicy>(renderer, points.data(), static_cast<int>(points.size()));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError, size_t N>
+    typename ErrorPolicy::result_type sdl_render_draw_lines_f(Renderer& renderer, const std::array<SDL_FPoint, N>& points) {
+        return sdl_render_draw_lines_f<ErrorPolicy>(renderer, points.data(), static_cast<int>(N));
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_copy(Renderer& renderer, Texture& texture, const SDL_Rect* srcRect, const SDL_Rect* dstRect) {
+        SDL2_PROFILE_SCOPE("sdl_render_copy");
+        return ErrorPolicy::check(SDL_RenderCopy(renderer.get(), texture.get(), srcRect, dstRect), "SDL_RenderCopy() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_copy_ex(Renderer& renderer, 
+                                                        Texture& texture, 
+                                                        const SDL_Rect* srcRect, 
+                                                        const SDL_Rect* dstRect, 
+                                                        const double angle,
+                                                        const SDL_Point* center,
+                                                        const SDL_RendererFlip flip) {
+        SDL2_PROFILE_SCOPE("sdl_render_copy_ex");
+        return ErrorPolicy::check(SDL_RenderCopyEx(renderer.get(), texture.get(), srcRect, dstRect, angle, center, flip), "SDL_RenderCopyEx() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_set_scale(Renderer& renderer, float scaleX, float scaleY) {
+        return ErrorPolicy::check(SDL_RenderSetScale(renderer.get(), scaleX, scaleY), "SDL_RenderSetScale() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_set_viewport(Renderer& renderer, const SDL_Rect* rect) {
+        return ErrorPolicy::check(SDL_RenderSetViewport(renderer.get(), rect), "SDL_RenderSetViewport() failed");
+    }
+
+    void sdl_render_present(Renderer& renderer) noexcept {
+        SDL2_PROFILE_SCOPE("sdl_render_present");
+        SDL2_PROFILE_FRAME();
+        SDL_RenderPresent(renderer.get());
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    Texture sdl_create_texture_from_surface(Renderer& renderer, SDL_Surface* surface) {
+        SDL2_PROFILE_UPLOAD("sdl_create_texture_from_surface", surface ? surface->h * surface->pitch : 0);
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer.get(), surface);
+        ErrorPolicy::check_ptr(texture, "SDL_CreateTextureFromSurface() failed");
+
+        return Texture{ texture };
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_query_texture(Texture& texture, uint32_t* format, int* access, int* w, int* h) {
+        return ErrorPolicy::check(SDL_QueryTexture(texture.get(), format, access, w, h), "SDL_QueryTexture() failed");
+    }
+
+    // needs SDL 2.0.18 or later.
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_render_geometry(Renderer& renderer, SDL_Texture* texture, const SDL_Vertex* vertices, int vertexNum, const int* indices, int indexNum) {
+        SDL2_PROFILE_SCOPE("sdl_render_geometry");
+        return ErrorPolicy::check(SDL_RenderGeometry(renderer.get(), texture, vertices, vertexNum, indices, indexNum), "SDL_RenderGeometry() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_update_texture(Texture& texture, const SDL_Rect* rect, const void* pixels, int pitch) {
+        SDL2_PROFILE_SCOPE("sdl_update_texture");
+        return ErrorPolicy::check(SDL_UpdateTexture(texture.get(), rect, pixels, pitch), "SDL_UpdateTexture() failed");
+    }
+
+    // nullptr goes back to the window.
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type sdl_set_render_target(Renderer& renderer, SDL_Texture* texture) {
+        return ErrorPolicy::check(SDL_SetRenderTarget(renderer.get(), texture), "SDL_SetRenderTarget() failed");
+    }
+
+    /*
+        a triple buffer of frames in cpu memory, to hand frames from one producer thread to the render thread without locks.
+        the producer writes into write_buffer() then publish(), the render thread takes the latest published frame with acquire().
+        frames published faster than they are acquired are dropped, neither side ever waits.
+    */
+    class PixelMailbox {
+        static const int FRESH = 4;
+
+        int width;
+        int height;
+        int pitch;
+        std::vector<uint8_t> pixels;
+        int writeIndex;
+        int readIndex;
+        std::atomic<int> middle;
+    public:
+        PixelMailbox(int _width, int _height, int bytesPerPixel = 4)
+            : width{ _width }, height{ _height }, pitch{ _width * bytesPerPixel }, pixels(static_cast<size_t>(_width * bytesPerPixel) * _height * 3),
+              writeIndex{ 0 }, readIndex{ 1 }, middle{ 2 } {}
+
+        PixelMailbox(const PixelMailbox&) = delete;
+        PixelMailbox& operator=(const PixelMailbox&) = delete;
+
+        ~PixelMailbox() {}
+
+        // producer side.
+        uint8_t* write_buffer() noexcept {
+            return pixels.data() + static_cast<size_t>(writeIndex) * pitch * height;
+        }
+
+        void publish() noexcept {
+            writeIndex = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & 3;
+        }
+
+        // render thread side, returns the latest frame, or nullptr if nothing was published since the last call.
+        const uint8_t* acquire() noexcept {
+            if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+                return nullptr;
+            }
+
+            readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & 3;
+            return pixels.data() + static_cast<size_t>(readIndex) * pitch * height;
+        }
+
+        int get_width() const noexcept {
+            return width;
+        }
+
+        int get_height() const noexcept {
+            return height;
+        }
+
+        int get_pitch() const noexcept {
+            return pitch;
+        }
+    };
+
+    /*
+        a ring of SDL_TEXTUREACCESS_STREAMING textures, get() is the one to show, lock() writes the next one,
+        swap() makes the written one current. with 2 or more buffers, the driver can still read the shown texture
+        while the next one is written.
+
+            {
+                sdl2::StreamingTexture::Lock lock = video.lock();
+                decode_into(lock.get_pixels(), lock.get_pitch());
+            }
+            video.swap();
+            sdl2::sdl_render_copy(renderer, video.get(), nullptr, nullptr);
+
+        lock(rect) only rewrites rect, and SDL doesn't keep the old pixels inside it,
+        the rest of the texture keeps the frame written bufferNum swaps ago,
+        so for partial updates use 1 buffer, or write every rect changed since then.
+    */
+    class StreamingTexture {
+        std::vector<Texture> textures;
+        size_t current;
+        int width;
+        int height;
+        uint32_t format;
+    public:
+        // unlocks the texture when destroyed, the pixels are write only.
+        class Lock {
+            SDL_Texture* texture;
+            uint8_t* pixels;
+            int pitch;
+            int width;
+            int height;
+        public:
+            Lock(SDL_Texture* _texture, const SDL_Rect* rect) : texture{ _texture }, pixels{ nullptr }, pitch{ 0 }, width{ 0 }, height{ 0 } {
+                void* p = nullptr;
+                if (SDL_LockTexture(texture, rect, &p, &pitch) < 0) {
+                    const char* sdlErrMsg = SDL_GetError();
+                    throw SDL2Exception{ "SDL_LockTexture() failed", sdlErrMsg };
+                }
+
+                pixels = static_cast<uint8_t*>(p);
+                if (rect) {
+                    width = rect->w;
+                    height = rect->h;
+                }
+                else {
+                    SDL_QueryTexture(texture, nullptr, nullptr, &width, &height);
+                }
+            }
+
+            Lock(const Lock&) = delete;
+            Lock& operator=(const Lock&) = delete;
+
+            Lock(Lock&& other) noexcept
+                : texture{ other.texture }, pixels{ other.pixels }, pitch{ other.pitch }, width{ other.width }, height{ other.height }
+            {
+                other.texture = nullptr;
+            }
+
+            Lock& operator=(Lock&&) = delete;
+
+            ~Lock() {
+                if (texture) {
+                    SDL_UnlockTexture(texture);
+                }
+            }
+
+            uint8_t* get_pixels() noexcept {
+                return pixels;
+            }
+
+            int get_pitch() const noexcept {
+                return pitch;
+            }
+
+            uint8_t* row(int y) noexcept {
+                return pixels + static_cast<size_t>(y) * pitch;
+            }
+
+            int get_width() const noexcept {
+                return width;
+            }
+
+            int get_height() const noexcept {
+                return height;
+            }
+        };
+
+        StreamingTexture(Renderer& renderer, int _width, int _height, uint32_t _format = SDL_PIXELFORMAT_ARGB8888, size_t bufferNum = 2)
+            : textures{}, current{ 0 }, width{ _width }, height{ _height }, format{ _format }
+        {
+            for (size_t i = 0; i < std::max<size_t>(bufferNum, 1); ++i) {
+                SDL_Texture* texture = SDL_CreateTexture(renderer.get(), format, SDL_TEXTUREACCESS_STREAMING, width, height);
+                if (texture == nullptr) {
+                    const char* sdlErrMsg = SDL_GetError();
+                    throw SDL2Exception{ "SDL_CreateTexture() failed", sdlErrMsg };
+                }
+
+                textures.emplace_back(texture);
+            }
+        }
+
+        StreamingTexture(const StreamingTexture&) = delete;
+        StreamingTexture& operator=(const StreamingTexture&) = delete;
+        StreamingTexture(StreamingTexture&&) = default;
+        StreamingTexture& operator=(StreamingTexture&&) = default;
+
+        ~StreamingTexture() {}
+
+        // the texture to show.
+        Texture& get() noexcept {
+            return textures[current];
+        }
+
+        // locks the next texture, a null rect locks all of it.
+        Lock lock(const SDL_Rect* rect = nullptr) {
+            SDL2_PROFILE_SCOPE("StreamingTexture::lock");
+            return Lock{ textures[(current + 1) % textures.size()].get(), rect };
+        }
+
+        // copies pixels into the next texture.
+        void update(const SDL_Rect* rect, const void* pixels, int pitch) {
+            SDL2_PROFILE_UPLOAD("StreamingTexture::update", static_cast<uint64_t>(pitch) * (rect ? rect->h : height));
+            sdl_update_texture(textures[(current + 1) % textures.size()], rect, pixels, pitch);
+        }
+
+        // the last locked or updated texture becomes the one to show.
+        void swap() noexcept {
+            current = (current + 1) % textures.size();
+        }
+
+        // uploads and shows the latest frame of the mailbox, returns false if there was no new one.
+        bool update(PixelMailbox& mailbox) {
+            const uint8_t* pixels = mailbox.acquire();
+            if (pixels == nullptr) {
+                return false;
+            }
+
+            SDL_Rect rect = { 0, 0, std::min(width, mailbox.get_width()), std::min(height, mailbox.get_height()) };
+            update(&rect, pixels, mailbox.get_pitch());
+            swap();
+            return true;
+        }
+
+        size_t buffer_count() const noexcept {
+            return textures.size();
+        }
+
+        int get_width() const noexcept {
+            return width;
+        }
+
+        int get_height() const noexcept {
+            return height;
+        }
+
+        uint32_t get_format() const noexcept {
+            return format;
+        }
+    };
+
+    /*
+        a sub rect of an atlas page, returned by Atlas::add().
+    */
+    struct AtlasRegion {
+        int page;
+        SDL_Rect rect;
+    };
+
+    /*
+        packs many small surfaces into a few big textures (pages), using the skyline bottom-left packer.
+        every page is a SDL_PIXELFORMAT_ARGB8888 static texture with SDL_BLENDMODE_BLEND, cleared to transparent,
+        surfaces in other formats are converted before uploading.
+    */
+    class Atlas {
+        struct SkylineNode {
+            int x;
+            int y;
+            int w;
+        };
+
+        struct Page {
+            Texture texture;
+            std::vector<SkylineNode> skyline;
+        };
+
+        int pageWidth;
+        int pageHeight;
+        int padding;
+        std::vector<Page> pages;
+
+        // returns the y position where a w * h rect fits at node index, or -1 if it doesn't fit.
+        int skyline_fit(const std::vector<SkylineNode>& skyline, size_t index, int w, int h) const noexcept {
+            int x = skyline[index].x;
+            if (x + w > pageWidth) {
+                return -1;
+            }
+
+            int y = 0;
+            int widthLeft = w;
+            for (size_t i = index; widthLeft > 0; ++i) {
+                if (i == skyline.size()) {
+                    return -1;
+                }
+
+                y = std::max(y, skyline[i].y);
+                if (y + h > pageHeight) {
+                    return -1;
+                }
+
+                widthLeft -= skyline[i].w;
+            }
+
+            return y;
+        }
+
+        bool skyline_insert(std::vector<SkylineNode>& skyline, int w, int h, SDL_Point& pos) const {
+            int bestIndex = -1;
+            int bestY = INT_MAX;
+            int bestWidth = INT_MAX;
+
+            for (size_t i = 0; i < skyline.size(); ++i) {
+                int y = skyline_fit(skyline, i, w, h);
+                if (y >= 0 && (y + h < bestY || (y + h == bestY && skyline[i].w < bestWidth))) {
+                    bestIndex = static_cast<int>(i);
+                    bestY = y + h;
+                    bestWidth = skyline[i].w;
+                }
+            }
+
+            if (bestIndex < 0) {
+                return false;
+            }
+
+            pos.x = skyline[bestIndex].x;
+            pos.y = bestY - h;
+
+            SkylineNode node = { pos.x, bestY, w };
+            skyline.insert(skyline.begin() + bestIndex, node);
+
+            // shrink or remove the nodes covered by the new one.
+            for (size_t i = bestIndex + 1; i < skyline.size(); ) {
+                int prevEnd = skyline[i - 1].x + skyline[i - 1].w;
+                if (skyline[i].x >= prevEnd) {
+                    break;
+                }
+
+                int shrink = prevEnd - skyline[i].x;
+                skyline[i].x += shrink;
+                skyline[i].w -= shrink;
+
+                if (skyline[i].w <= 0) {
+                    skyline.erase(skyline.begin() + i);
+                }
+                else {
+                    break;
+                }
+            }
+
+            // merge the neighbours with the same height.
+            for (size_t i = 0; i + 1 < skyline.size(); ) {
+                if (skyline[i].y == skyline[i + 1].y) {
+                    skyline[i].w += skyline[i + 1].w;
+                    skyline.erase(skyline.begin() + i + 1);
+                }
+                else {
+                    ++i;
+                }
+            }
+
+            return true;
+        }
+
+        void add_page(Renderer& renderer) {
+            SDL_Texture* texture = SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, pageWidth, pageHeight);
+            if (texture == nullptr) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_CreateTexture() failed", sdlErrMsg };
+            }
+
+            Page page;
+            page.texture.set(texture);
+            page.skyline.push_back(SkylineNode{ 0, 0, pageWidth });
+
+            if (SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) < 0) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_SetTextureBlendMode() failed", sdlErrMsg };
+            }
+
+            // a static texture starts undefined, the padding between the regions must be transparent,
+            // else linear filtering bleeds it into the sprites. cleared once, in bands of rows.
+            int bandRows = std::min(pageHeight, 64);
+            std::vector<uint32_t> zeros(static_cast<size_t>(pageWidth) * bandRows, 0);
+            for (int y = 0; y < pageHeight; y += bandRows) {
+                SDL_Rect band = { 0, y, pageWidth, std::min(bandRows, pageHeight - y) };
+                if (SDL_UpdateTexture(texture, &band, zeros.data(), pageWidth * 4) < 0) {
+                    const char* sdlErrMsg = SDL_GetError();
+                    throw SDL2Exception{ "SDL_UpdateTexture() failed", sdlErrMsg };
+                }
+            }
+
+            pages.push_back(std::move(page));
+        }
+
+        void upload(Page& page, const SDL_Rect& rect, SDL_Surface* surface) {
+            Surface converted;
+            if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+                converted.set(SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0));
+                if (converted.get() == nullptr) {
+                    const char* sdlErrMsg = SDL_GetError();
+                    throw SDL2Exception{ "SDL_ConvertSurfaceFormat() failed", sdlErrMsg };
+                }
+
+                surface = converted.get();
+            }
+
+            bool mustLock = SDL_MUSTLOCK(surface);
+            if (mustLock && SDL_LockSurface(surface) < 0) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_LockSurface() failed", sdlErrMsg };
+            }
+
+            SDL2_PROFILE_UPLOAD("Atlas::add", rect.h * surface->pitch);
+            int ret = SDL_UpdateTexture(page.texture.get(), &rect, surface->pixels, surface->pitch);
+
+            if (mustLock) {
+                SDL_UnlockSurface(surface);
+            }
+
+            if (ret < 0) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_UpdateTexture() failed", sdlErrMsg };
+            }
+        }
+    public:
+        Atlas(int _pageWidth, int _pageHeight, int _padding = 1)
+            : pageWidth{ _pageWidth }, pageHeight{ _pageHeight }, padding{ _padding }, pages{}
+        {}
+
+        Atlas(const Atlas&) = delete;
+        Atlas& operator=(const Atlas&) = delete;
+
+        Atlas(Atlas&&) = default;
+        Atlas& operator=(Atlas&&) = default;
+
+        ~Atlas() {}
+
+        /*
+            copies the surface into the first page that has room for it,
+            a new page is created if none of them has.
+        */
+        AtlasRegion add(Renderer& renderer, SDL_Surface* surface) {
+            if (surface == nullptr) {
+                throw SDL2Exception{ "Atlas::add() failed", "surface is null" };
+            }
+
+            int w = surface->w + padding;
+            int h = surface->h + padding;
+            if (w > pageWidth || h > pageHeight) {
+                throw SDL2Exception{ "Atlas::add() failed", "surface is larger than the atlas page" };
+            }
+
+            SDL_Point pos = { 0, 0 };
+            size_t index = 0;
+            for (; index < pages.size(); ++index) {
+                if (skyline_insert(pages[index].skyline, w, h, pos)) {
+                    break;
+                }
+            }
+
+            if (index == pages.size()) {
+                add_page(renderer);
+                skyline_insert(pages.back().skyline, w, h, pos);
+            }
+
+            AtlasRegion region = { static_cast<int>(index), SDL_Rect{ pos.x, pos.y, surface->w, surface->h } };
+            upload(pages[index], region.rect, surface);
+            return region;
+        }
+
+        Texture& page_texture(int page) {
+            if (page < 0 || page >= static_cast<int>(pages.size())) {
+                throw SDL2Exception{ "Atlas::page_texture() failed", "page index out of range" };
+            }
+
+            return pages[page].texture;
+        }
+
+        int page_count() const noexcept {
+            return static_cast<int>(pages.size());
+        }
+
+        int page_width() const noexcept {
+            return pageWidth;
+        }
+
+        int page_height() const noexcept {
+            return pageHeight;
+        }
+
+        // destroys all the pages, every region returned before becomes invalid.
+        void clear() noexcept {
+            pages.clear();
+        }
+    };
+
+    namespace kernels {
+        // the sprites of a SpriteBatch, as structure of arrays so the quad generation can load 4 sprites at once.
+        struct SpriteArrays {
+            std::vector<float> x;
+            std::vector<float> y;
+            std::vector<float> w;
+            std::vector<float> h;
+            std::vector<float> centerX;       // rotation center, relative to (x, y).
+            std::vector<float> centerY;
+            std::vector<float> angle;         // radians, clockwise.
+            std::vector<float> u0;            // texture coordinates, already swapped by the flip.
+            std::vector<float> v0;
+            std::vector<float> u1;
+            std::vector<float> v1;
+            std::vector<SDL_Color> color;
+
+            size_t size() const noexcept {
+                return x.size();
+            }
+
+            void reserve(size_t n) {
+                x.reserve(n);
+                y.reserve(n);
+                w.reserve(n);
+                h.reserve(n);
+                centerX.reserve(n);
+                centerY.reserve(n);
+                angle.reserve(n);
+                u0.reserve(n);
+                v0.reserve(n);
+                u1.reserve(n);
+                v1.reserve(n);
+                color.reserve(n);
+            }
+
+            void clear() noexcept {
+                x.clear();
+                y.clear();
+                w.clear();
+                h.clear();
+                centerX.clear();
+                centerY.clear();
+                angle.clear();
+                u0.clear();
+                v0.clear();
+                u1.clear();
+                v1.clear();
+                color.clear();
+            }
+        };
+
+        /*
+            sin / cos with a quadrant reduction and the cephes minimax polynomials on [-pi / 4, pi / 4],
+            about 1e-7 absolute error for the angles sprites use, far below a pixel.
+        */
+        const float PIO2_INV = 0.636619772367581f;
+        const float PIO2_HI = 1.5707963705062866f;
+        const float PIO2_LO = -4.37113900018624283e-8f;
+        const float SIN_P0 = -1.6666654611e-1f;
+        const float SIN_P1 = 8.3321608736e-3f;
+        const float SIN_P2 = -1.9515295891e-4f;
+        const float COS_P0 = 4.166664568298827e-2f;
+        const float COS_P1 = -1.388731625493765e-3f;
+        const float COS_P2 = 2.443315711809948e-5f;
+
+        inline void sincos_scalar(float a, float& s, float& c) noexcept {
+            int q = static_cast<int>(std::lrint(a * PIO2_INV));
+            float r = a - q * PIO2_HI - q * PIO2_LO;
+            float r2 = r * r;
+            float sp = r + r * r2 * (SIN_P0 + r2 * (SIN_P1 + r2 * SIN_P2));
+            float cp = 1.0f - 0.5f * r2 + r2 * r2 * (COS_P0 + r2 * (COS_P1 + r2 * COS_P2));
+
+            s = (q & 1) ? cp : sp;
+            c = (q & 1) ? sp : cp;
+            s = (q & 2) ? -s : s;
+            c = ((q + 1) & 2) ? -c : c;
+        }
+
+        /*
+            writes the 4 vertices of sprite i, in the SDL_RenderCopyEx() order: top left, top right, bottom right, bottom left.
+            x + (cx + (c * dx - s * dy)) keeps the unrotated corners exact when the center is in the middle.
+        */
+        inline void sprite_vertices(const SpriteArrays& sprites, size_t i, float s, float c, SDL_Vertex* out) noexcept {
+            float x = sprites.x[i];
+            float y = sprites.y[i];
+            float cx = sprites.centerX[i];
+            float cy = sprites.centerY[i];
+            float dx0 = -cx;
+            float dx1 = sprites.w[i] - cx;
+            float dy0 = -cy;
+            float dy1 = sprites.h[i] - cy;
+            SDL_Color color = sprites.color[i];
+
+            out[0] = SDL_Vertex{ SDL_FPoint{ x + (cx + (c * dx0 - s * dy0)), y + (cy + (s * dx0 + c * dy0)) }, color, SDL_FPoint{ sprites.u0[i], sprites.v0[i] } };
+            out[1] = SDL_Vertex{ SDL_FPoint{ x + (cx + (c * dx1 - s * dy0)), y + (cy + (s * dx1 + c * dy0)) }, color, SDL_FPoint{ sprites.u1[i], sprites.v0[i] } };
+            out[2] = SDL_Vertex{ SDL_FPoint{ x + (cx + (c * dx1 - s * dy1)), y + (cy + (s * dx1 + c * dy1)) }, color, SDL_FPoint{ sprites.u1[i], sprites.v1[i] } };
+            out[3] = SDL_Vertex{ SDL_FPoint{ x + (cx + (c * dx0 - s * dy1)), y + (cy + (s * dx0 + c * dy1)) }, color, SDL_FPoint{ sprites.u0[i], sprites.v1[i] } };
+        }
+
+        inline void sprite_quads_scalar(const SpriteArrays& sprites, size_t begin, SDL_Vertex* out) noexcept {
+            for (size_t i = begin; i < sprites.size(); ++i) {
+                float s, c;
+                sincos_scalar(sprites.angle[i], s, c);
+                sprite_vertices(sprites, i, s, c, out + 4 * i);
+            }
+        }
+
+#ifdef SDL2_WRAPPER_SSE2
+        inline void sincos_sse2(__m128 a, __m128& s, __m128& c) noexcept {
+            __m128i q = _mm_cvtps_epi32(_mm_mul_ps(a, _mm_set1_ps(PIO2_INV)));
+            __m128 qf = _mm_cvtepi32_ps(q);
+            __m128 r = _mm_sub_ps(_mm_sub_ps(a, _mm_mul_ps(qf, _mm_set1_ps(PIO2_HI))), _mm_mul_ps(qf, _mm_set1_ps(PIO2_LO)));
+            __m128 r2 = _mm_mul_ps(r, r);
+
+            __m128 sp = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(SIN_P2)), _mm_set1_ps(SIN_P1));
+            sp = _mm_add_ps(_mm_mul_ps(r2, sp), _mm_set1_ps(SIN_P0));
+            sp = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sp));
+
+            __m128 cp = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(COS_P2)), _mm_set1_ps(COS_P1));
+            cp = _mm_add_ps(_mm_mul_ps(r2, cp), _mm_set1_ps(COS_P0));
+            cp = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cp));
+
+            __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+            __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+            __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+            s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cp), _mm_andnot_ps(swap, sp)), sinSign);
+            c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sp), _mm_andnot_ps(swap, cp)), cosSign);
+        }
+
+        // 4 sprites per iteration, the corners are computed as vectors and scattered into the interleaved SDL_Vertex.
+        inline void sprite_quads_sse2(const SpriteArrays& sprites, size_t begin, SDL_Vertex* out) noexcept {
+            size_t i = begin;
+            for (; i + 4 <= sprites.size(); i += 4) {
+                __m128 s, c;
+                sincos_sse2(_mm_loadu_ps(&sprites.angle[i]), s, c);
+
+                __m128 x = _mm_loadu_ps(&sprites.x[i]);
+                __m128 y = _mm_loadu_ps(&sprites.y[i]);
+                __m128 cx = _mm_loadu_ps(&sprites.centerX[i]);
+                __m128 cy = _mm_loadu_ps(&sprites.centerY[i]);
+                __m128 dx[2] = { _mm_sub_ps(_mm_setzero_ps(), cx), _mm_sub_ps(_mm_loadu_ps(&sprites.w[i]), cx) };
+                __m128 dy[2] = { _mm_sub_ps(_mm_setzero_ps(), cy), _mm_sub_ps(_mm_loadu_ps(&sprites.h[i]), cy) };
+
+                // corner k uses dx[CORNER_X[k]], dy[CORNER_Y[k]].
+                const int CORNER_X[4] = { 0, 1, 1, 0 };
+                const int CORNER_Y[4] = { 0, 0, 1, 1 };
+                alignas(16) float px[4][4];
+                alignas(16) float py[4][4];
+                for (int k = 0; k < 4; ++k) {
+                    __m128 ddx = dx[CORNER_X[k]];
+                    __m128 ddy = dy[CORNER_Y[k]];
+                    _mm_store_ps(px[k], _mm_add_ps(x, _mm_add_ps(cx, _mm_sub_ps(_mm_mul_ps(c, ddx), _mm_mul_ps(s, ddy)))));
+                    _mm_store_ps(py[k], _mm_add_ps(y, _mm_add_ps(cy, _mm_add_ps(_mm_mul_ps(s, ddx), _mm_mul_ps(c, ddy)))));
+                }
+
+                for (int j = 0; j < 4; ++j) {
+                    SDL_Vertex* v = out + 4 * (i + j);
+                    SDL_Color color = sprites.color[i + j];
+                    float u0 = sprites.u0[i + j];
+                    float v0 = sprites.v0[i + j];
+                    float u1 = sprites.u1[i + j];
+                    float v1 = sprites.v1[i + j];
+
+                    v[0] = SDL_Vertex{ SDL_FPoint{ px[0][j], py[0][j] }, color, SDL_FPoint{ u0, v0 } };
+                    v[1] = SDL_Vertex{ SDL_FPoint{ px[1][j], py[1][j] }, color, SDL_FPoint{ u1, v0 } };
+                    v[2] = SDL_Vertex{ SDL_FPoint{ px[2][j], py[2][j] }, color, SDL_FPoint{ u1, v1 } };
+                    v[3] = SDL_Vertex{ SDL_FPoint{ px[3][j], py[3][j] }, color, SDL_FPoint{ u0, v1 } };
+                }
+            }
+
+            sprite_quads_scalar(sprites, i, out);
+        }
+#endif
+    }
+
+    /*
+        collects textured quads and submits all the quads sharing one texture in a single SDL_RenderGeometry() call.
+        quads are drawn in the order they are added, the batch flushes itself when the texture changes,
+        so sort your sprites by texture (or put them in one Atlas) to get the fewest draw calls.
+        call flush() before sdl_render_present().
+
+        draw_ex() takes the sdl_render_copy_ex() angle, center and flip. the sprites are kept as structure of arrays
+        and flush() builds every quad at once (SSE2 when available) into a vertex arena reused across frames.
+    */
+    class SpriteBatch {
+        typedef void (*QuadsFunc)(const kernels::SpriteArrays&, size_t, SDL_Vertex*);
+
+        Renderer& renderer;
+        SDL_Texture* texture;
+        float invWidth;
+        float invHeight;
+        kernels::SpriteArrays sprites;
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+        QuadsFunc buildQuads;
+        size_t drawCalls;
+
+        void bind(SDL_Texture* _texture, int w, int h) {
+            if (_texture != texture) {
+                flush();
+                texture = _texture;
+                invWidth = 1.0f / w;
+                invHeight = 1.0f / h;
+            }
+        }
+
+        void bind(Texture& _texture) {
+            if (_texture.get() != texture) {
+                int w, h;
+                sdl_query_texture(_texture, nullptr, nullptr, &w, &h);
+                bind(_texture.get(), w, h);
+            }
+        }
+
+        void push_sprite(const SDL_Rect& srcRect, const SDL_FRect& dstRect, float angle, float centerX, float centerY, SDL_RendererFlip flip, SDL_Color color) {
+            float u0 = srcRect.x * invWidth;
+            float v0 = srcRect.y * invHeight;
+            float u1 = (srcRect.x + srcRect.w) * invWidth;
+            float v1 = (srcRect.y + srcRect.h) * invHeight;
+            if (flip & SDL_FLIP_HORIZONTAL) {
+                std::swap(u0, u1);
+            }
+
+            if (flip & SDL_FLIP_VERTICAL) {
+                std::swap(v0, v1);
+            }
+
+            sprites.x.push_back(dstRect.x);
+            sprites.y.push_back(dstRect.y);
+            sprites.w.push_back(dstRect.w);
+            sprites.h.push_back(dstRect.h);
+            sprites.centerX.push_back(centerX);
+            sprites.centerY.push_back(centerY);
+            sprites.angle.push_back(angle);
+            sprites.u0.push_back(u0);
+            sprites.v0.push_back(v0);
+            sprites.u1.push_back(u1);
+            sprites.v1.push_back(v1);
+            sprites.color.push_back(color);
+        }
+
+        void push_sprite_ex(const SDL_Rect& srcRect, const SDL_FRect& dstRect, double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color) {
+            // the reduction inside the kernels is only exact for moderate angles.
+            if (angle > 360.0 || angle < -360.0) {
+                angle = std::fmod(angle, 360.0);
+            }
+
+            float radians = static_cast<float>(angle * 0.017453292519943295);
+            push_sprite(srcRect, dstRect, radians,
+                        center != nullptr ? center->x : dstRect.w * 0.5f,
+                        center != nullptr ? center->y : dstRect.h * 0.5f,
+                        flip, color);
+        }
+    public:
+        SpriteBatch(Renderer& _renderer, size_t reserveSprites = 1024)
+            : renderer{ _renderer }, texture{ nullptr }, invWidth{ 0 }, invHeight{ 0 }, sprites{}, vertices{}, indices{}, buildQuads{ kernels::sprite_quads_scalar }, drawCalls{ 0 }
+        {
+            sprites.reserve(reserveSprites);
+            vertices.reserve(reserveSprites * 4);
+            indices.reserve(reserveSprites * 6);
+
+#ifdef SDL2_WRAPPER_SSE2
+            if (SDL_HasSSE2()) {
+                buildQuads = kernels::sprite_quads_sse2;
+            }
+#endif
+        }
+
+        SpriteBatch(const SpriteBatch&) = delete;
+        SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+        ~SpriteBatch() {}
+
+        void draw(Texture& _texture, const SDL_Rect& srcRect, const SDL_FRect& dstRect, SDL_Color color = SDL_Color{ 255, 255, 255, 255 }) {
+            bind(_texture);
+            push_sprite(srcRect, dstRect, 0, dstRect.w * 0.5f, dstRect.h * 0.5f, SDL_FLIP_NONE, color);
+        }
+
+        void draw(Atlas& atlas, const AtlasRegion& region, const SDL_FRect& dstRect, SDL_Color color = SDL_Color{ 255, 255, 255, 255 }) {
+            bind(atlas.page_texture(region.page).get(), atlas.page_width(), atlas.page_height());
+            push_sprite(region.rect, dstRect, 0, dstRect.w * 0.5f, dstRect.h * 0.5f, SDL_FLIP_NONE, color);
+        }
+
+        // same meaning as sdl_render_copy_ex(): angle in degrees clockwise, center relative to dstRect (nullptr for its middle).
+        void draw_ex(Texture& _texture, const SDL_Rect& srcRect, const SDL_FRect& dstRect, double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color = SDL_Color{ 255, 255, 255, 255 }) {
+            bind(_texture);
+            push_sprite_ex(srcRect, dstRect, angle, center, flip, color);
+        }
+
+        void draw_ex(Atlas& atlas, const AtlasRegion& region, const SDL_FRect& dstRect, double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color = SDL_Color{ 255, 255, 255, 255 }) {
+            bind(atlas.page_texture(region.page).get(), atlas.page_width(), atlas.page_height());
+            push_sprite_ex(region.rect, dstRect, angle, center, flip, color);
+        }
+
+        void flush() {
+            // the texture is bound again by the next draw(), a destroyed one may be replaced by a new one at the same address.
+            SDL_Texture* batchTexture = texture;
+            texture = nullptr;
+
+            size_t spriteNum = sprites.size();
+            if (spriteNum != 0) {
+                SDL2_PROFILE_SCOPE("SpriteBatch::flush");
+
+                // the index pattern never changes, it is only extended when a batch is bigger than all the previous ones.
+                for (size_t i = indices.size() / 6; i < spriteNum; ++i) {
+                    int base = static_cast<int>(i * 4);
+                    indices.push_back(base);
+                    indices.push_back(base + 1);
+                    indices.push_back(base + 2);
+                    indices.push_back(base);
+                    indices.push_back(base + 2);
+                    indices.push_back(base + 3);
+                }
+
+                vertices.resize(spriteNum * 4);
+                buildQuads(sprites, 0, vertices.data());
+                sprites.clear();
+
+                sdl_render_geometry(renderer, batchTexture, vertices.data(), static_cast<int>(spriteNum * 4), indices.data(), static_cast<int>(spriteNum * 6));
+                ++drawCalls;
+            }
+        }
+
+        // sprites waiting for the next flush().
+        size_t size() const noexcept {
+            return sprites.size();
+        }
+
+        // number of SDL_RenderGeometry() calls since the last reset_draw_calls().
+        size_t draw_calls() const noexcept {
+            return drawCalls;
+        }
+
+        void reset_draw_calls() noexcept {
+            drawCalls = 0;
+        }
+    };
+
+    // an object of a SpatialGrid, ids are reused after remove().
+    typedef uint32_t SpatialId;
+
+    struct CullStats {
+        size_t objects;          // objects in the grid.
+        size_t visible;          // objects returned by the last query.
+        size_t culled;           // objects skipped by it, objects - visible.
+        size_t candidates;       // objects found in the visited cells, before the exact bounds test.
+        size_t cellsVisited;     // non-empty cells the last query looked at.
+    };
+
+    /*
+        a uniform grid over the objects bounds, so a frame only submits the objects inside the camera view
+        instead of letting SDL clip every one of them after the draw call.
+        cells are hashed, so the world has no fixed size, and a moving object only touches the grid when it crosses a cell border.
+        pick a cell size around the size of the view divided by 4 to 8, bigger than most objects.
+
+            sdl2::SpatialGrid grid{ 256 };
+            sdl2::SpatialId id = grid.insert(bounds, &enemy);
+            grid.move(id, newBounds);
+            for (sdl2::SpatialId visible : grid.query_view(renderer, cameraX, cameraY)) {
+                draw(*static_cast<Enemy*>(grid.user_data(visible)));
+            }
+    */
+    class SpatialGrid {
+        struct Object {
+            SDL_FRect bounds;
+            int cellX0;
+            int cellY0;
+            int cellX1;
+            int cellY1;
+            void* userData;
+            uint32_t mark;         // the query which already returned it, objects can span many cells.
+            bool alive;
+        };
+
+        float cellSize;
+        float invCellSize;
+        std::unordered_map<uint64_t, std::vector<SpatialId>> cells;
+        std::vector<Object> objects;
+        std::vector<SpatialId> freeIds;
+        std::vector<SpatialId> visible;
+        uint32_t queryMark;
+        size_t objectNum;
+        CullStats stats;
+
+        static uint64_t cell_key(int x, int y) noexcept {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+        }
+
+        int cell_of(float v) const noexcept {
+            return static_cast<int>(std::floor(v * invCellSize));
+        }
+
+        void link(SpatialId id) {
+            const Object& object = objects[id];
+            for (int y = object.cellY0; y <= object.cellY1; ++y) {
+                for (int x = object.cellX0; x <= object.cellX1; ++x) {
+                    cells[cell_key(x, y)].push_back(id);
+                }
+            }
+        }
+
+        void unlink(SpatialId id) {
+            const Object& object = objects[id];
+            for (int y = object.cellY0; y <= object.cellY1; ++y) {
+                for (int x = object.cellX0; x <= object.cellX1; ++x) {
+                    auto it = cells.find(cell_key(x, y));
+                    SDL_assert(it != cells.end());
+                    std::vector<SpatialId>& cell = it->second;
+                    *std::find(cell.begin(), cell.end(), id) = cell.back();
+                    cell.pop_back();
+                    if (cell.empty()) {
+                        cells.erase(it);
+                    }
+                }
+            }
+        }
+
+        void set_bounds(Object& object, const SDL_FRect& bounds) noexcept {
+            object.bounds = bounds;
+            object.cellX0 = cell_of(bounds.x);
+            object.cellY0 = cell_of(bounds.y);
+            object.cellX1 = cell_of(bounds.x + bounds.w);
+            object.cellY1 = cell_of(bounds.y + bounds.h);
+        }
+
+        static SDL_FRect to_frect(const SDL_Rect& rect) noexcept {
+            return SDL_FRect{ static_cast<float>(rect.x), static_cast<float>(rect.y), static_cast<float>(rect.w), static_cast<float>(rect.h) };
+        }
+
+        // unlink() of a removed or unknown id would write out of the cells, so it is checked in every build.
+        void check_alive(SpatialId id, const char* func) const {
+            if (id >= objects.size() || !objects[id].alive) {
+                throw SDL2Exception{ func, "the id is not in the grid" };
+            }
+        }
+    public:
+        SpatialGrid(float _cellSize = 256.0f)
+            : cellSize{ _cellSize }, invCellSize{ 1.0f / _cellSize }, cells{}, objects{}, freeIds{}, visible{}, queryMark{ 0 }, objectNum{ 0 }, stats{}
+        {}
+
+        SpatialGrid(const SpatialGrid&) = delete;
+        SpatialGrid& operator=(const SpatialGrid&) = delete;
+
+        ~SpatialGrid() {}
+
+        SpatialId insert(const SDL_FRect& bounds, void* userData = nullptr) {
+            SpatialId id;
+            if (!freeIds.empty()) {
+                id = freeIds.back();
+                freeIds.pop_back();
+            }
+            else {
+                id = static_cast<SpatialId>(objects.size());
+                objects.push_back(Object{});
+            }
+
+            Object& object = objects[id];
+            set_bounds(object, bounds);
+            object.userData = userData;
+            object.mark = queryMark;
+            object.alive = true;
+            link(id);
+            ++objectNum;
+
+            return id;
+        }
+
+        SpatialId insert(const SDL_Rect& bounds, void* userData = nullptr) {
+            return insert(to_frect(bounds), userData);
+        }
+
+        // only touches the cells when the object crossed a cell border. throws if id was removed.
+        void move(SpatialId id, const SDL_FRect& bounds) {
+            check_alive(id, "SpatialGrid::move() failed");
+            Object& object = objects[id];
+            if (cell_of(bounds.x) == object.cellX0 && cell_of(bounds.y) == object.cellY0
+                && cell_of(bounds.x + bounds.w) == object.cellX1 && cell_of(bounds.y + bounds.h) == object.cellY1) {
+                object.bounds = bounds;
+                return;
+            }
+
+            unlink(id);
+            set_bounds(objects[id], bounds);
+            link(id);
+        }
+
+        void move(SpatialId id, const SDL_Rect& bounds) {
+            move(id, to_frect(bounds));
+        }
+
+        // throws if id was removed already, it may be returned by a later insert().
+        void remove(SpatialId id) {
+            check_alive(id, "SpatialGrid::remove() failed");
+            unlink(id);
+            objects[id].alive = false;
+            objects[id].userData = nullptr;
+            freeIds.push_back(id);
+            --objectNum;
+        }
+
+        void clear() noexcept {
+            cells.clear();
+            objects.clear();
+            freeIds.clear();
+            visible.clear();
+            objectNum = 0;
+        }
+
+        /*
+            the objects overlapping area, sorted by id so the draw order stays the same from frame to frame.
+            the returned vector is reused by the next query.
+        */
+        const std::vector<SpatialId>& query(const SDL_FRect& area) {
+            SDL2_PROFILE_SCOPE("SpatialGrid::query");
+
+            visible.clear();
+            stats.candidates = 0;
+            stats.cellsVisited = 0;
+
+            // a new mark, the old ones are reset when it wraps.
+            if (++queryMark == 0) {
+                for (Object& object : objects) {
+                    object.mark = 0;
+                }
+
+                queryMark = 1;
+            }
+
+            float areaX1 = area.x + area.w;
+            float areaY1 = area.y + area.h;
+            int cellX0 = cell_of(area.x);
+            int cellY0 = cell_of(area.y);
+            int cellX1 = cell_of(areaX1);
+            int cellY1 = cell_of(areaY1);
+
+            for (int y = cellY0; y <= cellY1; ++y) {
+                for (int x = cellX0; x <= cellX1; ++x) {
+                    auto it = cells.find(cell_key(x, y));
+                    if (it == cells.end()) {
+                        continue;
+                    }
+
+                    ++stats.cellsVisited;
+                    for (SpatialId id : it->second) {
+                        Object& object = objects[id];
+                        if (object.mark == queryMark) {
+                            continue;
+                        }
+
+                        object.mark = queryMark;
+                        ++stats.candidates;
+                        const SDL_FRect& b = object.bounds;
+                        if (b.x < areaX1 && area.x < b.x + b.w && b.y < areaY1 && area.y < b.y + b.h) {
+                            visible.push_back(id);
+                        }
+                    }
+                }
+            }
+
+            std::sort(visible.begin(), visible.end());
+            stats.objects = objectNum;
+            stats.visible = visible.size();
+            stats.culled = objectNum - visible.size();
+            return visible;
+        }
+
+        const std::vector<SpatialId>& query(const SDL_Rect& area) {
+            return query(to_frect(area));
+        }
+
+        /*
+            the objects inside the renderer viewport, with the camera at (cameraX, cameraY) in world coordinates.
+            SDL_RenderGetViewport() already returns the viewport in the units of sdl_render_set_scale().
+        */
+        const std::vector<SpatialId>& query_view(Renderer& renderer, float cameraX, float cameraY) {
+            SDL_Rect viewport;
+            SDL_RenderGetViewport(renderer.get(), &viewport);
+            return query(SDL_FRect{ cameraX, cameraY, static_cast<float>(viewport.w), static_cast<float>(viewport.h) });
+        }
+
+        const SDL_FRect& get_bounds(SpatialId id) const noexcept {
+            return objects[id].bounds;
+        }
+
+        void* user_data(SpatialId id) const noexcept {
+            return objects[id].userData;
+        }
+
+        size_t size() const noexcept {
+            return objectNum;
+        }
+
+        float get_cell_size() const noexcept {
+            return cellSize;
+        }
+
+        // the stats of the last query.
+        CullStats get_stats() const noexcept {
+            return stats;
+        }
+    };
+
+    struct TileMapStats {
+        size_t chunksDrawn;        // chunk copies of the last draw().
+        size_t chunksRendered;     // chunks re-rendered into their texture by the last draw().
+        size_t tilesRendered;      // tile copies made for them.
+        size_t texturesCreated;    // chunk textures created since the map was created.
+        size_t evictions;          // chunk textures taken from another chunk since the map was created.
+    };
+
+    /*
+        a tile map split into square chunks, each chunk is rendered once into a render target texture
+        and drawn with a single copy, set_tile() only marks its chunk for a re-render.
+        the chunk textures are pooled, at most maxTextures of them live at once (more only if the view needs more),
+        the least recently drawn chunk gives its texture away, so the cost of a frame depends on the screen size, not the map size.
+
+        tile i of the tileset is at ((i % columns) * tileWidth, (i / columns) * tileHeight), EMPTY_TILE draws nothing.
+        render target contents are lost on SDL_RENDER_TARGETS_RESET / SDL_RENDER_DEVICE_RESET, call invalidate() then.
+    */
+    class TileMap {
+        struct Chunk {
+            int texture;           // index in textures, -1 if it has none.
+            bool dirty;
+        };
+
+        struct ChunkTexture {
+            Texture texture;
+            int chunk;             // -1 if free.
+            uint64_t lastDrawn;
+        };
+
+        Renderer& renderer;
+        Texture& tileset;
+        int tileWidth;
+        int tileHeight;
+        int tilesetColumns;
+        int width;
+        int height;
+        int chunkTiles;
+        int chunksX;
+        int chunksY;
+        size_t maxTextures;
+        std::vector<uint16_t> tiles;
+        std::vector<Chunk> chunks;
+        std::vector<ChunkTexture> textures;
+        uint64_t frame;
+        TileMapStats stats;
+
+        int acquire_texture(int chunk) {
+            int best = -1;
+            for (size_t i = 0; i < textures.size(); ++i) {
+                if (textures[i].chunk == -1) {
+                    best = static_cast<int>(i);
+                    break;
+                }
+
+                // a texture already drawn this frame can't be given away.
+                if (textures[i].lastDrawn != frame && (best == -1 || textures[i].lastDrawn < textures[best].lastDrawn)) {
+                    best = static_cast<int>(i);
+                }
+            }
+
+            if (best == -1 || (textures[best].chunk != -1 && textures.size() < maxTextures)) {
+                SDL_Texture* texture = SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, chunkTiles * tileWidth, chunkTiles * tileHeight);
+                if (texture == nullptr) {
+                    const char* sdlErrMsg = SDL_GetError();
+                    throw SDL2Exception{ "SDL_CreateTexture() failed", sdlErrMsg };
+                }
+
+                SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+                textures.push_back(ChunkTexture{ Texture{ texture }, -1, 0 });
+                ++stats.texturesCreated;
+                best = static_cast<int>(textures.size() - 1);
+            }
+            else if (textures[best].chunk != -1) {
+                chunks[textures[best].chunk].texture = -1;
+                ++stats.evictions;
+            }
+
+            textures[best].chunk = chunk;
+            chunks[chunk].texture = best;
+            chunks[chunk].dirty = true;
+            return best;
+        }
+
+        // the caller already set the chunk texture as the render target.
+        void render_chunk(int chunk) {
+            sdl_render_clear(renderer);
+
+            int tileX0 = (chunk % chunksX) * chunkTiles;
+            int tileY0 = (chunk / chunksX) * chunkTiles;
+            int tileX1 = std::min(tileX0 + chunkTiles, width);
+            int tileY1 = std::min(tileY0 + chunkTiles, height);
+            for (int y = tileY0; y < tileY1; ++y) {
+                for (int x = tileX0; x < tileX1; ++x) {
+                    uint16_t tile = tiles[static_cast<size_t>(y) * width + x];
+                    if (tile == EMPTY_TILE) {
+                        continue;
+                    }
+
+                    SDL_Rect srcRect = { (tile % tilesetColumns) * tileWidth, (tile / tilesetColumns) * tileHeight, tileWidth, tileHeight };
+                    SDL_Rect dstRect = { (x - tileX0) * tileWidth, (y - tileY0) * tileHeight, tileWidth, tileHeight };
+                    sdl_render_copy(renderer, tileset, &srcRect, &dstRect);
+                    ++stats.tilesRendered;
+                }
+            }
+
+            chunks[chunk].dirty = false;
+            ++stats.chunksRendered;
+        }
+    public:
+        static const uint16_t EMPTY_TILE = 0xffff;
+
+        TileMap(Renderer& _renderer, Texture& _tileset, int _tileWidth, int _tileHeight, int _width, int _height, int _chunkTiles = 32, size_t _maxTextures = 64)
+            : renderer{ _renderer }, tileset{ _tileset }, tileWidth{ _tileWidth }, tileHeight{ _tileHeight }, tilesetColumns{ 1 },
+              width{ _width }, height{ _height }, chunkTiles{ _chunkTiles },
+              chunksX{ (_width + _chunkTiles - 1) / _chunkTiles }, chunksY{ (_height + _chunkTiles - 1) / _chunkTiles }, maxTextures{ _maxTextures },
+              tiles(static_cast<size_t>(_width) * _height, uint16_t{ EMPTY_TILE }), chunks{}, textures{}, frame{ 0 }, stats{}
+        {
+            int tilesetWidth;
+            sdl_query_texture(tileset, nullptr, nullptr, &tilesetWidth, nullptr);
+            tilesetColumns = std::max(tilesetWidth / tileWidth, 1);
+            chunks.assign(static_cast<size_t>(chunksX) * chunksY, Chunk{ -1, true });
+        }
+
+        TileMap(const TileMap&) = delete;
+        TileMap& operator=(const TileMap&) = delete;
+
+        ~TileMap() {}
+
+        void set_tile(int x, int y, uint16_t tile) noexcept {
+            uint16_t& current = tiles[static_cast<size_t>(y) * width + x];
+            if (current != tile) {
+                current = tile;
+                chunks[(y / chunkTiles) * chunksX + x / chunkTiles].dirty = true;
+            }
+        }
+
+        uint16_t get_tile(int x, int y) const noexcept {
+            return tiles[static_cast<size_t>(y) * width + x];
+        }
+
+        // re-renders every chunk on its next draw, for when the render targets were lost.
+        void invalidate() noexcept {
+            for (Chunk& chunk : chunks) {
+                chunk.dirty = true;
+            }
+        }
+
+        // destroys all the chunk textures, they are created again as the chunks come into view.
+        void release_textures() noexcept {
+            for (Chunk& chunk : chunks) {
+                chunk.texture = -1;
+                chunk.dirty = true;
+            }
+
+            textures.clear();
+        }
+
+        /*
+            draws the chunks inside the renderer viewport, with the camera at (cameraX, cameraY) in map pixels.
+            the dirty chunks are all re-rendered before any chunk is drawn: the render target is set once
+            per dirty chunk, then once back, and not at all in a frame without dirty chunks.
+            the render target, draw color and tileset blend mode are put back, also when it throws.
+        */
+        void draw(int cameraX, int cameraY) {
+            SDL2_PROFILE_SCOPE("TileMap::draw");
+
+            ++frame;
+            stats.chunksDrawn = 0;
+            stats.chunksRendered = 0;
+            stats.tilesRendered = 0;
+
+            SDL_Rect viewport;
+            SDL_RenderGetViewport(renderer.get(), &viewport);
+            int chunkWidth = chunkTiles * tileWidth;
+            int chunkHeight = chunkTiles * tileHeight;
+            int chunkX0 = std::max(cameraX, 0) / chunkWidth;
+            int chunkY0 = std::max(cameraY, 0) / chunkHeight;
+            int chunkX1 = std::min((cameraX + viewport.w - 1) / chunkWidth, chunksX - 1);
+            int chunkY1 = std::min((cameraY + viewport.h - 1) / chunkHeight, chunksY - 1);
+            if (cameraX + viewport.w <= 0 || cameraY + viewport.h <= 0 || chunkX0 > chunkX1 || chunkY0 > chunkY1) {
+                return;
+            }
+
+            SDL_Texture* oldTarget = SDL_GetRenderTarget(renderer.get());
+            uint8_t r, g, b, a;
+            SDL_GetRenderDrawColor(renderer.get(), &r, &g, &b, &a);
+            SDL_BlendMode tilesetBlend;
+            SDL_GetTextureBlendMode(tileset.get(), &tilesetBlend);
+
+            // the tiles of a chunk never overlap, so they are copied as is, alpha included.
+            SDL_SetTextureBlendMode(tileset.get(), SDL_BLENDMODE_NONE);
+            SDL_SetRenderDrawColor(renderer.get(), 0, 0, 0, 0);
+
+            bool targetChanged = false;
+            try {
+                for (int y = chunkY0; y <= chunkY1; ++y) {
+                    for (int x = chunkX0; x <= chunkX1; ++x) {
+                        int chunk = y * chunksX + x;
+                        int texture = chunks[chunk].texture;
+                        if (texture == -1) {
+                            texture = acquire_texture(chunk);
+                        }
+
+                        textures[texture].lastDrawn = frame;
+                        if (chunks[chunk].dirty) {
+                            sdl_set_render_target(renderer, textures[texture].texture.get());
+                            targetChanged = true;
+                            render_chunk(chunk);
+                        }
+                    }
+                }
+            }
+            catch (...) {
+                // unchecked, the first error is the one reported.
+                if (targetChanged) {
+                    SDL_SetRenderTarget(renderer.get(), oldTarget);
+                }
+
+                SDL_SetTextureBlendMode(tileset.get(), tilesetBlend);
+                SDL_SetRenderDrawColor(renderer.get(), r, g, b, a);
+                throw;
+            }
+
+            SDL_SetTextureBlendMode(tileset.get(), tilesetBlend);
+            SDL_SetRenderDrawColor(renderer.get(), r, g, b, a);
+
+            if (targetChanged) {
+                sdl_set_render_target(renderer, oldTarget);
+            }
+
+            for (int y = chunkY0; y <= chunkY1; ++y) {
+                for (int x = chunkX0; x <= chunkX1; ++x) {
+                    ChunkTexture& texture = textures[chunks[y * chunksX + x].texture];
+                    SDL_Rect dstRect = { x * chunkWidth - cameraX, y * chunkHeight - cameraY, chunkWidth, chunkHeight };
+                    sdl_render_copy(renderer, texture.texture, nullptr, &dstRect);
+                    ++stats.chunksDrawn;
+                }
+            }
+        }
+
+        int get_width() const noexcept {
+            return width;
+        }
+
+        int get_height() const noexcept {
+            return height;
+        }
+
+        int get_chunk_tiles() const noexcept {
+            return chunkTiles;
+        }
+
+        size_t texture_count() const noexcept {
+            return textures.size();
+        }
+
+        TileMapStats get_stats() const noexcept {
+            return stats;
+        }
+    };
+
+    struct RenderCommandStats {
+        size_t commands;              // commands recorded.
+        size_t drawCalls;             // SDL draw calls issued for them.
+        size_t stateChanges;          // SDL state calls issued.
+        size_t stateChangesSkipped;   // state calls skipped because the state was already set.
+    };
+
+    /*
+        records draw commands together with their render state, and replays them on flush():
+        commands are sorted by layer, viewport / scale, texture, blend mode and color,
+        redundant state calls are skipped, adjacent rect and point commands are merged into
+        SDL_RenderFillRects() / SDL_RenderDrawRects() / SDL_RenderDrawPoints(),
+        connected lines into SDL_RenderDrawLines().
+
+        inside one layer the draw order is NOT kept, put the commands which overlap on different layers.
+        recording never touches the renderer, so a buffer can be filled on any thread.
+    */
+    class CommandBuffer {
+        enum class Kind : uint8_t {
+            FillRect,
+            DrawRect,
+            Line,
+            Point,
+            Copy
+        };
+
+        struct State {
+            SDL_Color color;
+            SDL_BlendMode blendMode;
+            SDL_Rect viewport;
+            bool hasViewport;
+            float scaleX;
+            float scaleY;
+            uint32_t viewGroup;    // changes whenever viewport or scale changes.
+        };
+
+        struct Command {
+            int layer;
+            uint32_t seq;
+            uint32_t state;
+            Kind kind;
+            SDL_Texture* texture;
+            SDL_Rect rect;         // rect, line (x, y) -> (w, h), or point.
+            uint32_t copy;         // index in copies.
+        };
+
+        struct CopyParams {
+            SDL_Rect srcRect;
+            SDL_Rect dstRect;
+            SDL_Point center;
+            double angle;
+            SDL_RendererFlip flip;
+            bool hasSrc;
+            bool hasDst;
+            bool hasCenter;
+            bool rotated;
+        };
+
+        // the renderer state flush() changes, put back by the destructor.
+        class RendererState {
+            Renderer& renderer;
+            SDL_Rect viewport;
+            float scaleX;
+            float scaleY;
+            uint8_t r, g, b, a;
+            SDL_BlendMode blendMode;
+        public:
+            RendererState(Renderer& _renderer) : renderer{ _renderer } {
+                SDL_RenderGetViewport(renderer.get(), &viewport);
+                SDL_RenderGetScale(renderer.get(), &scaleX, &scaleY);
+                SDL_GetRenderDrawColor(renderer.get(), &r, &g, &b, &a);
+                SDL_GetRenderDrawBlendMode(renderer.get(), &blendMode);
+            }
+
+            RendererState(const RendererState&) = delete;
+            RendererState& operator=(const RendererState&) = delete;
+
+            // the viewport is in the units of the scale, so the scale goes back first.
+            ~RendererState() {
+                SDL_RenderSetScale(renderer.get(), scaleX, scaleY);
+                SDL_RenderSetViewport(renderer.get(), &viewport);
+                SDL_SetRenderDrawColor(renderer.get(), r, g, b, a);
+                SDL_SetRenderDrawBlendMode(renderer.get(), blendMode);
+            }
+        };
+
+        State current;
+        bool currentRecorded;
+        int layer;
+        bool hasClear;
+        SDL_Color clearColor;
+        std::vector<State> states;
+        std::vector<Command> commands;
+        std::vector<CopyParams> copies;
+        std::vector<SDL_Rect> rectScratch;
+        std::vector<SDL_Point> pointScratch;
+        RenderCommandStats stats;
+
+        static uint32_t pack_color(SDL_Color c) noexcept {
+            return (static_cast<uint32_t>(c.r) << 24) | (static_cast<uint32_t>(c.g) << 16) | (static_cast<uint32_t>(c.b) << 8) | c.a;
+        }
+
+        static bool same_draw_state(const State& a, const State& b) noexcept {
+            return a.blendMode == b.blendMode && pack_color(a.color) == pack_color(b.color);
+        }
+
+        static bool same_view(const State& a, const State& b) noexcept {
+            return a.hasViewport == b.hasViewport && a.scaleX == b.scaleX && a.scaleY == b.scaleY
+                && (!a.hasViewport || (a.viewport.x == b.viewport.x && a.viewport.y == b.viewport.y && a.viewport.w == b.viewport.w && a.viewport.h == b.viewport.h));
+        }
+
+        Command& record(Kind kind, SDL_Texture* texture) {
+            if (!currentRecorded) {
+                states.push_back(current);
+                currentRecorded = true;
+            }
+
+            Command cmd;
+            cmd.layer = layer;
+            cmd.seq = static_cast<uint32_t>(commands.size());
+            cmd.state = static_cast<uint32_t>(states.size() - 1);
+            cmd.kind = kind;
+            cmd.texture = texture;
+            cmd.rect = SDL_Rect{ 0, 0, 0, 0 };
+            cmd.copy = 0;
+
+            commands.push_back(cmd);
+            ++stats.commands;
+            return commands.back();
+        }
+
+        bool same_batch(const Command& a, const Command& b) const noexcept {
+            if (a.kind != b.kind || a.layer != b.layer || a.texture != b.texture || a.kind == Kind::Copy) {
+                return false;
+            }
+
+            const State& sa = states[a.state];
+            const State& sb = states[b.state];
+            if (sa.viewGroup != sb.viewGroup || !same_draw_state(sa, sb)) {
+                return false;
+            }
+
+            // lines are only merged when they form a polyline.
+            return a.kind != Kind::Line || (a.rect.w == b.rect.x && a.rect.h == b.rect.y);
+        }
+
+        void apply_view(Renderer& renderer, const State& state, const State*& applied) {
+            if (applied != nullptr && same_view(*applied, state)) {
+                stats.stateChangesSkipped += 2;
+                return;
+            }
+
+            sdl_render_set_viewport(renderer, state.hasViewport ? &state.viewport : nullptr);
+            sdl_render_set_scale(renderer, state.scaleX, state.scaleY);
+            stats.stateChanges += 2;
+            applied = &state;
+        }
+
+        void apply_draw_state(Renderer& renderer, const State& state, const State*& applied) {
+            if (applied != nullptr && pack_color(applied->color) == pack_color(state.color)) {
+                ++stats.stateChangesSkipped;
+            }
+            else {
+                sdl_set_render_draw_color(renderer, state.color.r, state.color.g, state.color.b, state.color.a);
+                ++stats.stateChanges;
+            }
+
+            if (applied != nullptr && applied->blendMode == state.blendMode) {
+                ++stats.stateChangesSkipped;
+            }
+            else {
+                sdl_set_render_draw_blend_mode(renderer, state.blendMode);
+                ++stats.stateChanges;
+            }
+
+            applied = &state;
+        }
+
+        void draw_copy(Renderer& renderer, const Command& cmd) {
+            const CopyParams& p = copies[cmd.copy];
+            const SDL_Rect* srcRect = p.hasSrc ? &p.srcRect : nullptr;
+            const SDL_Rect* dstRect = p.hasDst ? &p.dstRect : nullptr;
+
+            int ret = p.rotated
+                ? SDL_RenderCopyEx(renderer.get(), cmd.texture, srcRect, dstRect, p.angle, p.hasCenter ? &p.center : nullptr, p.flip)
+                : SDL_RenderCopy(renderer.get(), cmd.texture, srcRect, dstRect);
+
+            if (ret < 0) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ p.rotated ? "SDL_RenderCopyEx() failed" : "SDL_RenderCopy() failed", sdlErrMsg };
+            }
+        }
+
+        // draws commands[begin, end), which all share one batch.
+        void draw_batch(Renderer& renderer, size_t begin, size_t end) {
+            const Command& first = commands[begin];
+            rectScratch.clear();
+            pointScratch.clear();
+
+            switch (first.kind) {
+            case Kind::FillRect:
+            case Kind::DrawRect:
+                for (size_t i = begin; i < end; ++i) {
+                    rectScratch.push_back(commands[i].rect);
+                }
+
+                if (first.kind == Kind::FillRect) {
+                    sdl_render_fill_rects(renderer, rectScratch);
+                }
+                else {
+                    sdl_render_draw_rects(renderer, rectScratch);
+                }
+                break;
+            case Kind::Line:
+                pointScratch.push_back(SDL_Point{ first.rect.x, first.rect.y });
+                for (size_t i = begin; i < end; ++i) {
+                    pointScratch.push_back(SDL_Point{ commands[i].rect.w, commands[i].rect.h });
+                }
+
+                sdl_render_draw_lines(renderer, pointScratch);
+                break;
+            case Kind::Point:
+                for (size_t i = begin; i < end; ++i) {
+                    pointScratch.push_back(SDL_Point{ commands[i].rect.x, commands[i].rect.y });
+                }
+
+                sdl_render_draw_points(renderer, pointScratch);
+                break;
+            case Kind::Copy:
+                draw_copy(renderer, first);
+                break;
+            }
+
+            ++stats.drawCalls;
+        }
+
+        // empties the buffer, the stats are left to the caller.
+        void discard() noexcept {
+            hasClear = false;
+            commands.clear();
+            copies.clear();
+            states.clear();
+            currentRecorded = false;
+        }
+    public:
+        CommandBuffer()
+            : current{}, currentRecorded{ false }, layer{ 0 }, hasClear{ false }, clearColor{ 0, 0, 0, 255 },
+              states{}, commands{}, copies{}, rectScratch{}, pointScratch{}, stats{}
+        {
+            reset_state();
+        }
+
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+        CommandBuffer(CommandBuffer&&) = default;
+        CommandBuffer& operator=(CommandBuffer&&) = default;
+
+        ~CommandBuffer() {}
+
+        void set_layer(int _layer) noexcept {
+            layer = _layer;
+        }
+
+        // back to the state of a new buffer: opaque black, SDL_BLENDMODE_NONE, the whole target, scale 1, layer 0.
+        void reset_state() noexcept {
+            current.color = SDL_Color{ 0, 0, 0, 255 };
+            current.blendMode = SDL_BLENDMODE_NONE;
+            current.viewport = SDL_Rect{ 0, 0, 0, 0 };
+            current.hasViewport = false;
+            current.scaleX = 1.0f;
+            current.scaleY = 1.0f;
+            ++current.viewGroup;
+            currentRecorded = false;
+            layer = 0;
+        }
+
+        void set_draw_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+            current.color = SDL_Color{ r, g, b, a };
+            currentRecorded = false;
+        }
+
+        void set_draw_blend_mode(SDL_BlendMode blendMode) {
+            current.blendMode = blendMode;
+            currentRecorded = false;
+        }
+
+        // nullptr means the whole target, like SDL_RenderSetViewport().
+        void set_viewport(const SDL_Rect* rect) {
+            current.hasViewport = rect != nullptr;
+            current.viewport = rect ? *rect : SDL_Rect{ 0, 0, 0, 0 };
+            ++current.viewGroup;
+            currentRecorded = false;
+        }
+
+        void set_scale(float scaleX, float scaleY) {
+            current.scaleX = scaleX;
+            current.scaleY = scaleY;
+            ++current.viewGroup;
+            currentRecorded = false;
+        }
+
+        // clears the target with the current draw color, the commands recorded before are dropped.
+        void clear() {
+            hasClear = true;
+            clearColor = current.color;
+            stats.commands -= commands.size();
+            commands.clear();
+            copies.clear();
+        }
+
+        void fill_rect(const SDL_Rect& rect) {
+            record(Kind::FillRect, nullptr).rect = rect;
+        }
+
+        void draw_rect(const SDL_Rect& rect) {
+            record(Kind::DrawRect, nullptr).rect = rect;
+        }
+
+        void draw_line(int x1, int y1, int x2, int y2) {
+            record(Kind::Line, nullptr).rect = SDL_Rect{ x1, y1, x2, y2 };
+        }
+
+        void draw_point(int x, int y) {
+            record(Kind::Point, nullptr).rect = SDL_Rect{ x, y, 0, 0 };
+        }
+
+        void copy(Texture& texture, const SDL_Rect* srcRect, const SDL_Rect* dstRect) {
+            copy_ex(texture, srcRect, dstRect, 0, nullptr, SDL_FLIP_NONE);
+        }
+
+        void copy_ex(Texture& texture,
+                     const SDL_Rect* srcRect,
+                     const SDL_Rect* dstRect,
+                     const double angle,
+                     const SDL_Point* center,
+                     const SDL_RendererFlip flip) {
+            CopyParams p;
+            p.srcRect = srcRect ? *srcRect : SDL_Rect{ 0, 0, 0, 0 };
+            p.dstRect = dstRect ? *dstRect : SDL_Rect{ 0, 0, 0, 0 };
+            p.center = center ? *center : SDL_Point{ 0, 0 };
+            p.angle = angle;
+            p.flip = flip;
+            p.hasSrc = srcRect != nullptr;
+            p.hasDst = dstRect != nullptr;
+            p.hasCenter = center != nullptr;
+            p.rotated = angle != 0 || center != nullptr || flip != SDL_FLIP_NONE;
+
+            copies.push_back(p);
+            record(Kind::Copy, texture.get()).copy = static_cast<uint32_t>(copies.size() - 1);
+        }
+
+        /*
+            sorts and submits every recorded command, then empties the buffer.
+            call it right before sdl_render_present(). the draw color, blend mode, scale and viewport
+            of the renderer are put back when it returns or throws, a viewport of the whole target
+            comes back as the same rect set explicitly.
+        */
+        void flush(Renderer& renderer) {
+            RendererState saved{ renderer };
+            stats.stateChanges += 4;
+
+            const State* appliedView = nullptr;
+            const State* appliedDraw = nullptr;
+
+            if (hasClear) {
+                // SDL_RenderClear() ignores the viewport, so only the draw color matters.
+                sdl_set_render_draw_color(renderer, clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+                sdl_render_clear(renderer);
+                ++stats.stateChanges;
+                ++stats.drawCalls;
+            }
+
+            std::vector<State>& s = states;
+            std::sort(commands.begin(), commands.end(), [&s](const Command& a, const Command& b) {
+                if (a.layer != b.layer) {
+                    return a.layer < b.layer;
+                }
+
+                const State& sa = s[a.state];
+                const State& sb = s[b.state];
+                if (sa.viewGroup != sb.viewGroup) {
+                    return sa.viewGroup < sb.viewGroup;
+                }
+
+                if (a.texture != b.texture) {
+                    return std::less<SDL_Texture*>()(a.texture, b.texture);
+                }
+
+                if (sa.blendMode != sb.blendMode) {
+                    return sa.blendMode < sb.blendMode;
+                }
+
+                if (pack_color(sa.color) != pack_color(sb.color)) {
+                    return pack_color(sa.color) < pack_color(sb.color);
+                }
+
+                if (a.kind != b.kind) {
+                    return a.kind < b.kind;
+                }
+
+                return a.seq < b.seq;
+            });
+
+            for (size_t begin = 0; begin < commands.size(); ) {
+                size_t end = begin + 1;
+                while (end < commands.size() && same_batch(commands[end - 1], commands[end])) {
+                    ++end;
+                }
+
+                const Command& first = commands[begin];
+                apply_view(renderer, states[first.state], appliedView);
+                if (first.kind != Kind::Copy) {
+                    apply_draw_state(renderer, states[first.state], appliedDraw);
+                }
+
+                draw_batch(renderer, begin, end);
+                begin = end;
+            }
+
+            discard();
+        }
+
+        // drops the recorded commands without drawing them, the current state is kept.
+        void reset() noexcept {
+            stats.commands -= commands.size();
+            discard();
+        }
+
+        size_t size() const noexcept {
+            return commands.size();
+        }
+
+        const RenderCommandStats& get_stats() const noexcept {
+            return stats;
+        }
+
+        void reset_stats() noexcept {
+            stats = RenderCommandStats{};
+        }
+    };
+
+    struct RenderThreadStats {
+        uint64_t framesSubmitted;
+        uint64_t framesPresented;
+        double fenceWaitMilliSeconds;    // total time begin_frame() waited for a free command buffer.
+    };
+
+    /*
+        a thread which creates and owns the Renderer, so the simulation of frame N + 1 runs while frame N is drawn.
+        the main thread records each frame into the CommandBuffer returned by begin_frame() then submit()s it,
+        the render thread flush()es and presents it. framesInFlight buffers are used in turn, begin_frame() waits
+        while they are all submitted and not presented yet. the buffers keep their memory, so once warmed up
+        a frame allocates nothing. begin_frame() resets the state of the buffer (CommandBuffer::reset_state()),
+        so nothing leaks from the frame recorded in it before.
+
+        textures are made and destroyed with invoke(), its task runs on the render thread in submission order:
+        after the frames submitted before the invoke() call are presented, before the frames submitted after it.
+        so a texture destroyed by invoke() is no longer used by a pending CommandBuffer.
+        an exception of the render thread is rethrown by the next begin_frame().
+        some platforms (macOS, most OpenGL drivers) want the renderer on the main thread, keep to one thread there.
+
+            sdl2::RenderThread renderThread{ window, -1, SDL_RENDERER_ACCELERATED };
+            sdl2::Texture cat = renderThread.invoke([&bmp](sdl2::Renderer& renderer) {
+                return sdl2::sdl_create_texture_from_surface(renderer, bmp.get());
+            }).get();
+
+            while (running) {
+                simulate();
+                sdl2::CommandBuffer& commands = renderThread.begin_frame();
+                commands.copy(cat, nullptr, &rect);
+                renderThread.submit();
+            }
+
+            renderThread.invoke([&cat](sdl2::Renderer&) { sdl2::Texture destroyed{ std::move(cat) }; }).get();
+    */
+    class RenderThread {
+        static const size_t NONE = SIZE_MAX;
+
+        std::vector<CommandBuffer> buffers;
+        std::vector<size_t> freeBuffers;
+        std::vector<size_t> submitted;       // a ring of buffer indexes, presented in submit order.
+        size_t submittedHead;
+        size_t submittedNum;
+        size_t recording;
+        struct Task {
+            uint64_t afterFrames;            // the task waits until this many frames are presented.
+            std::function<void(Renderer&)> run;
+        };
+
+        std::deque<Task> tasks;
+        std::mutex mutex;
+        std::condition_variable cond;        // wakes the render thread.
+        std::condition_variable fence;       // wakes the main thread.
+        bool stopping;
+        std::exception_ptr error;
+        RenderThreadStats stats;
+        std::thread thread;
+
+        void run(Window& window, int index, uint32_t flags, std::promise<void>& started) {
+            std::unique_ptr<Renderer> renderer;
+            try {
+                renderer.reset(new Renderer{ window, index, flags });
+            }
+            catch (...) {
+                started.set_exception(std::current_exception());
+                return;
+            }
+
+            started.set_value();
+
+            while (true) {
+                std::function<void(Renderer&)> task;
+                size_t frame = NONE;
+                {
+                    std::unique_lock<std::mutex> lock{ mutex };
+                    cond.wait(lock, [this] { return stopping || !tasks.empty() || submittedNum != 0; });
+
+                    // a task waits for the frames submitted before it, those are always in the submitted ring.
+                    if (!tasks.empty() && tasks.front().afterFrames <= stats.framesPresented) {
+                        task = std::move(tasks.front().run);
+                        tasks.pop_front();
+                    }
+                    else if (submittedNum != 0) {
+                        frame = submitted[submittedHead];
+                    }
+                    else {
+                        return;
+                    }
+                }
+
+                if (task) {
+                    task(*renderer);
+                    continue;
+                }
+
+                std::exception_ptr frameError;
+                try {
+                    buffers[frame].flush(*renderer);
+                    sdl_render_present(*renderer);
+                }
+                catch (...) {
+                    buffers[frame].reset();
+                    frameError = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock{ mutex };
+                    submittedHead = (submittedHead + 1) % submitted.size();
+                    --submittedNum;
+                    freeBuffers.push_back(frame);
+                    ++stats.framesPresented;
+                    if (frameError && !error) {
+                        error = frameError;
+                    }
+                }
+
+                fence.notify_all();
+            }
+        }
+    public:
+        RenderThread(Window& window, int index, uint32_t flags, int framesInFlight = 2)
+            : buffers(static_cast<size_t>(std::max(framesInFlight, 1))), freeBuffers{}, submitted(buffers.size(), size_t{ NONE }), submittedHead{ 0 }, submittedNum{ 0 },
+              recording{ NONE }, tasks{}, mutex{}, cond{}, fence{}, stopping{ false }, error{}, stats{}, thread{}
+        {
+            freeBuffers.reserve(buffers.size());
+            for (size_t i = buffers.size(); i > 0; --i) {
+                freeBuffers.push_back(i - 1);
+            }
+
+            std::promise<void> started;
+            std::future<void> ready = started.get_future();
+            thread = std::thread([this, &window, index, flags, &started] { run(window, index, flags, started); });
+
+            try {
+                ready.get();
+            }
+            catch (...) {
+                thread.join();
+                throw;
+            }
+        }
+
+        RenderThread(const RenderThread&) = delete;
+        RenderThread& operator=(const RenderThread&) = delete;
+        RenderThread(RenderThread&&) = delete;
+        RenderThread& operator=(RenderThread&&) = delete;
+
+        // the frames and tasks already submitted still run, then the renderer is destroyed on its thread.
+        ~RenderThread() {
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                stopping = true;
+            }
+
+            cond.notify_one();
+            thread.join();
+        }
+
+        // the command buffer of the next frame, with the default state. waits while framesInFlight frames are not presented yet.
+        CommandBuffer& begin_frame() {
+            std::unique_lock<std::mutex> lock{ mutex };
+            SDL_assert(recording == NONE);
+
+            uint64_t begin = SDL_GetPerformanceCounter();
+            fence.wait(lock, [this] { return !freeBuffers.empty() || error; });
+            stats.fenceWaitMilliSeconds += static_cast<double>(SDL_GetPerformanceCounter() - begin) * 1000.0 / SDL_GetPerformanceFrequency();
+
+            if (error) {
+                std::exception_ptr e = error;
+                error = nullptr;
+                std::rethrow_exception(e);
+            }
+
+            recording = freeBuffers.back();
+            freeBuffers.pop_back();
+            buffers[recording].reset_state();
+            return buffers[recording];
+        }
+
+        // hands the buffer of begin_frame() to the render thread, it is replayed then presented.
+        void submit() {
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                SDL_assert(recording != NONE);
+
+                submitted[(submittedHead + submittedNum) % submitted.size()] = recording;
+                ++submittedNum;
+                recording = NONE;
+                ++stats.framesSubmitted;
+            }
+
+            cond.notify_one();
+        }
+
+        // runs f(renderer) on the render thread, after the frames already submitted are presented and before the next ones.
+        template <typename F, typename R = decltype(std::declval<F&>()(std::declval<Renderer&>()))>
+        std::future<R> invoke(F f) {
+            // std::function needs a copyable target, so the task is shared.
+            std::shared_ptr<std::packaged_task<R(Renderer&)>> task = std::make_shared<std::packaged_task<R(Renderer&)>>(std::move(f));
+            std::future<R> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                tasks.push_back(Task{ stats.framesSubmitted, [task](Renderer& renderer) { (*task)(renderer); } });
+            }
+
+            cond.notify_one();
+            return result;
+        }
+
+        // waits until every submitted frame is presented.
+        void finish() {
+            std::unique_lock<std::mutex> lock{ mutex };
+            fence.wait(lock, [this] { return submittedNum == 0 || error; });
+        }
+
+        size_t frames_in_flight() const noexcept {
+            return buffers.size();
+        }
+
+        RenderThreadStats get_stats() {
+            std::lock_guard<std::mutex> lock{ mutex };
+            return stats;
+        }
+    };
+
+    template <typename ErrorPolicy = ThrowOnError>
+    SDL_RWops* sdl_rw_from_const_mem(const void* mem, size_t size) {
+        // SDL takes an int size, a larger one would be truncated.
+        if (size > static_cast<size_t>(INT_MAX)) {
+            SDL_SetError("the buffer is larger than INT_MAX bytes");
+            ErrorPolicy::check_ptr(nullptr, "SDL_RWFromConstMem() failed");
+            return nullptr;
+        }
+
+        SDL_RWops* ops = SDL_RWFromConstMem(mem, static_cast<int>(size));
+        ErrorPolicy::check_ptr(ops, "SDL_RWFromConstMem() failed");
+
+        return ops;
+    }
+
+}
+
+/******************************* sdl2 mapped file part. **********************************/
+/*
+    the platform headers are only needed by MappedFile, AssetPack and TextureDiskCache,
+    define SDL2_WRAPPER_NO_MAPPED_FILE before including the header to leave them out with these classes.
+*/
+#ifndef SDL2_WRAPPER_NO_MAPPED_FILE
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace sdl2 {
+    /*
+        a read only memory mapping of a whole file.
+    */
+    class MappedFile {
+        const uint8_t* data;
+        size_t size;
+#ifdef _WIN32
+        HANDLE mapping;
+#endif
+
+        void unmap() noexcept {
+#ifdef _WIN32
+            if (data) {
+                UnmapViewOfFile(data);
+            }
+
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+#else
+            if (data) {
+                munmap(const_cast<uint8_t*>(data), size);
+            }
+#endif
+        }
+    public:
+#ifdef _WIN32
+        MappedFile(const std::string& filePath) : data{ nullptr }, size{ 0 }, mapping{ nullptr } {
+            HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                throw SDL2Exception{ "CreateFileA() failed", filePath.c_str() };
+            }
+
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize)) {
+                CloseHandle(file);
+                throw SDL2Exception{ "GetFileSizeEx() failed", filePath.c_str() };
+            }
+
+            size = static_cast<size_t>(fileSize.QuadPart);
+            if (size > 0) {
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                data = mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            }
+
+            CloseHandle(file);
+            if (size > 0 && data == nullptr) {
+                unmap();
+                throw SDL2Exception{ "MapViewOfFile() failed", filePath.c_str() };
+            }
+        }
+#else
+        MappedFile(const std::string& filePath) : data{ nullptr }, size{ 0 } {
+            int fd = open(filePath.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw SDL2Exception{ "open() failed", filePath.c_str() };
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) < 0) {
+                close(fd);
+                throw SDL2Exception{ "fstat() failed", filePath.c_str() };
+            }
+
+            size = static_cast<size_t>(st.st_size);
+            if (size > 0) {
+                void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED) {
+                    close(fd);
+                    throw SDL2Exception{ "mmap() failed", filePath.c_str() };
+                }
+
+                data = static_cast<const uint8_t*>(p);
+            }
+
+            // the mapping stays valid after the file is closed.
+            close(fd);
+        }
+#endif
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept
+            : data{ other.data }, size{ other.size }
+#ifdef _WIN32
+            , mapping{ other.mapping }
+#endif
+        {
+            other.data = nullptr;
+            other.size = 0;
+#ifdef _WIN32
+            other.mapping = nullptr;
+#endif
+        }
+
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this != &other) {
+                unmap();
+                data = other.data;
+                size = other.size;
+                other.data = nullptr;
+                other.size = 0;
+#ifdef _WIN32
+                mapping = other.mapping;
+                other.mapping = nullptr;
+#endif
+            }
+
+            return *this;
+        }
+
+        ~MappedFile() {
+            unmap();
+        }
+
+        const uint8_t* get() const noexcept {
+            return data;
+        }
+
+        size_t get_size() const noexcept {
+            return size;
+        }
+    };
+}
+#endif
+
+/******************************* sdl2 asset pack part. **********************************/
+namespace sdl2 {
+    /*
+        one asset inside an AssetPack, its bytes point into the mapping, so the pack must outlive it,
+        and everything opened from rw() that keeps reading later, like a Font.
+    */
+    struct PackEntry {
+        const char* name;
+        uint32_t nameLength;
+        uint32_t alignment;
+        const uint8_t* data;
+        size_t size;
+
+        std::string get_name() const {
+            return std::string{ name, nameLength };
+        }
+
+        // a view on the bytes, no copy.
+        SDL_RWops* rw() const {
+            return sdl_rw_from_const_mem(data, size);
+        }
+    };
+
+    /*
+        the pack format, all the integers are little endian:
+
+            header  "SDL2PACK", u32 version, u32 entry count, u64 index offset, u64 index size
+            data    the assets, each one starts at a multiple of its alignment
+            index   per asset, sorted by name: u64 offset, u64 size, u32 alignment, u32 name length, the name bytes
+
+        AssetPack maps the file and finds the assets by binary search on the index, AssetPackWriter writes it,
+        see pack_assets.cpp for the command line packer.
+    */
+    const char ASSET_PACK_MAGIC[8] = { 'S', 'D', 'L', '2', 'P', 'A', 'C', 'K' };
+    const uint32_t ASSET_PACK_VERSION = 1;
+    const size_t ASSET_PACK_HEADER_SIZE = 32;
+
+#ifndef SDL2_WRAPPER_NO_MAPPED_FILE
+    class AssetPack {
+        MappedFile file;
+        std::vector<PackEntry> index;
+
+        static uint32_t read_u32(const uint8_t* p) noexcept {
+            uint32_t value;
+            memcpy(&value, p, sizeof(value));
+            return SDL_SwapLE32(value);
+        }
+
+        static uint64_t read_u64(const uint8_t* p) noexcept {
+            uint64_t value;
+            memcpy(&value, p, sizeof(value));
+            return SDL_SwapLE64(value);
+        }
+
+        static bool name_less(const PackEntry& entry, const std::string& name) noexcept {
+            int cmp = memcmp(entry.name, name.data(), std::min<size_t>(entry.nameLength, name.size()));
+            return cmp < 0 || (cmp == 0 && entry.nameLength < name.size());
+        }
+    public:
+        AssetPack(const std::string& packFilePath) : file{ packFilePath }, index{} {
+            const uint8_t* data = file.get();
+            size_t size = file.get_size();
+
+            if (size < ASSET_PACK_HEADER_SIZE || memcmp(data, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC)) != 0) {
+                throw SDL2Exception{ "AssetPack() failed", "not an asset pack" };
+            }
+
+            if (read_u32(data + 8) != ASSET_PACK_VERSION) {
+                throw SDL2Exception{ "AssetPack() failed", "unsupported asset pack version" };
+            }
+
+            uint32_t entryNum = read_u32(data + 12);
+            uint64_t indexOffset = read_u64(data + 16);
+            uint64_t indexSize = read_u64(data + 24);
+            if (indexOffset > size || indexSize > size - indexOffset) {
+                throw SDL2Exception{ "AssetPack() failed", "the index is out of the file" };
+            }
+
+            index.reserve(entryNum);
+            const uint8_t* p = data + indexOffset;
+            const uint8_t* end = p + indexSize;
+            for (uint32_t i = 0; i < entryNum; ++i) {
+                if (end - p < 24) {
+                    throw SDL2Exception{ "AssetPack() failed", "the index is truncated" };
+                }
+
+                PackEntry entry;
+                uint64_t offset = read_u64(p);
+                uint64_t entrySize = read_u64(p + 8);
+                entry.alignment = read_u32(p + 16);
+                entry.nameLength = read_u32(p + 20);
+                p += 24;
+
+                if (static_cast<uint64_t>(end - p) < entry.nameLength || offset > size || entrySize > size - offset) {
+                    throw SDL2Exception{ "AssetPack() failed", "an entry is out of the file" };
+                }
+
+                entry.name = reinterpret_cast<const char*>(p);
+                entry.data = data + offset;
+                entry.size = static_cast<size_t>(entrySize);
+                p += entry.nameLength;
+
+                if (!index.empty() && !name_less(index.back(), entry.get_name())) {
+                    throw SDL2Exception{ "AssetPack() failed", "the index is not sorted" };
+                }
+
+                index.push_back(entry);
+            }
+        }
+
+        AssetPack(const AssetPack&) = delete;
+        AssetPack& operator=(const AssetPack&) = delete;
+        AssetPack(AssetPack&&) = default;
+        AssetPack& operator=(AssetPack&&) = default;
+
+        ~AssetPack() {}
+
+        // returns nullptr if the pack has no such asset.
+        const PackEntry* find(const std::string& name) const noexcept {
+            auto it = std::lower_bound(index.begin(), index.end(), name, name_less);
+            if (it == index.end() || it->nameLength != name.size() || memcmp(it->name, name.data(), name.size()) != 0) {
+                return nullptr;
+            }
+
+            return &*it;
+        }
+
+        const PackEntry& get(const std::string& name) const {
+            const PackEntry* entry = find(name);
+            if (entry == nullptr) {
+                throw SDL2Exception{ "AssetPack::get() failed", name.c_str() };
+            }
+
+            return *entry;
+        }
+
+        const std::vector<PackEntry>& entries() const noexcept {
+            return index;
+        }
+
+        size_t size() const noexcept {
+            return index.size();
+        }
+    };
+#endif
+
+    /*
+        collects files or memory blocks, then writes them as one pack.
+        alignment must be a power of 2.
+    */
+    class AssetPackWriter {
+        struct Item {
+            std::string name;
+            std::string filePath;
+            std::vector<uint8_t> bytes;
+            uint32_t alignment;
+        };
+
+        std::vector<Item> items;
+
+        static void write_bytes(SDL_RWops* ops, const void* data, size_t size) {
+            if (size > 0 && SDL_RWwrite(ops, data, size, 1) != 1) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_RWwrite() failed", sdlErrMsg };
+            }
+        }
+
+        static void append_u32(std::vector<uint8_t>& out, uint32_t value) {
+            value = SDL_SwapLE32(value);
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+            out.insert(out.end(), p, p + sizeof(value));
+        }
+
+        static void append_u64(std::vector<uint8_t>& out, uint64_t value) {
+            value = SDL_SwapLE64(value);
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+            out.insert(out.end(), p, p + sizeof(value));
+        }
+
+        static std::vector<uint8_t> read_file(const std::string& filePath) {
+            SDL_RWops* ops = SDL_RWFromFile(filePath.c_str(), "rb");
+            if (ops == nullptr) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_RWFromFile() failed", sdlErrMsg };
+            }
+
+            Sint64 size = SDL_RWsize(ops);
+            std::vector<uint8_t> bytes(size > 0 ? static_cast<size_t>(size) : 0);
+            size_t read = bytes.empty() ? 1 : SDL_RWread(ops, bytes.data(), bytes.size(), 1);
+            SDL_RWclose(ops);
+
+            if (size < 0 || read != 1) {
+                throw SDL2Exception{ "AssetPackWriter failed to read", filePath.c_str() };
+            }
+
+            return bytes;
+        }
+    public:
+        AssetPackWriter() : items{} {}
+
+        AssetPackWriter(const AssetPackWriter&) = delete;
+        AssetPackWriter& operator=(const AssetPackWriter&) = delete;
+
+        ~AssetPackWriter() {}
+
+        // the file is read by write().
+        void add_file(const std::string& name, const std::string& filePath, uint32_t alignment = 16) {
+            items.push_back(Item{ name, filePath, {}, alignment });
+        }
+
+        void add(const std::string& name, const void* data, size_t size, uint32_t alignment = 16) {
+            const uint8_t* p = static_cast<const uint8_t*>(data);
+            items.push_back(Item{ name, {}, std::vector<uint8_t>(p, p + size), alignment });
+        }
+
+        void write(const std::string& packFilePath) {
+            std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.name < b.name; });
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (i > 0 && items[i].name == items[i - 1].name) {
+                    throw SDL2Exception{ "AssetPackWriter::write() failed, duplicate name", items[i].name.c_str() };
+                }
+
+                uint32_t alignment = items[i].alignment;
+                if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+                    throw SDL2Exception{ "AssetPackWriter::write() failed, alignment is not a power of 2", items[i].name.c_str() };
+                }
+            }
+
+            SDL_RWops* ops = SDL_RWFromFile(packFilePath.c_str(), "wb");
+            if (ops == nullptr) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_RWFromFile() failed", sdlErrMsg };
+            }
+
+            try {
+                // the header is written last, once the index position is known.
+                const uint8_t zeros[ASSET_PACK_HEADER_SIZE] = {};
+                write_bytes(ops, zeros, ASSET_PACK_HEADER_SIZE);
+
+                std::vector<uint8_t> indexBytes;
+                uint64_t offset = ASSET_PACK_HEADER_SIZE;
+                std::vector<uint8_t> padding;
+                for (const Item& item : items) {
+                    std::vector<uint8_t> fileBytes;
+                    const std::vector<uint8_t>& bytes = item.filePath.empty() ? item.bytes : (fileBytes = read_file(item.filePath));
+
+                    uint64_t aligned = (offset + item.alignment - 1) & ~static_cast<uint64_t>(item.alignment - 1);
+                    padding.assign(static_cast<size_t>(aligned - offset), 0);
+                    write_bytes(ops, padding.data(), padding.size());
+                    write_bytes(ops, bytes.data(), bytes.size());
+
+                    append_u64(indexBytes, aligned);
+                    append_u64(indexBytes, bytes.size());
+                    append_u32(indexBytes, item.alignment);
+                    append_u32(indexBytes, static_cast<uint32_t>(item.name.size()));
+                    indexBytes.insert(indexBytes.end(), item.name.begin(), item.name.end());
+                    offset = aligned + bytes.size();
+                }
+
+                write_bytes(ops, indexBytes.data(), indexBytes.size());
+
+                std::vector<uint8_t> header{ ASSET_PACK_MAGIC, ASSET_PACK_MAGIC + sizeof(ASSET_PACK_MAGIC) };
+                append_u32(header, ASSET_PACK_VERSION);
+                append_u32(header, static_cast<uint32_t>(items.size()));
+                append_u64(header, offset);
+                append_u64(header, indexBytes.size());
+                if (SDL_RWseek(ops, 0, RW_SEEK_SET) < 0) {
+                    const char* sdlErrMsg = SDL_GetError();
+                    throw SDL2Exception{ "SDL_RWseek() failed", sdlErrMsg };
+                }
+
+                write_bytes(ops, header.data(), header.size());
+            }
+            catch (...) {
+                SDL_RWclose(ops);
+                throw;
+            }
+
+            if (SDL_RWclose(ops) < 0) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_RWclose() failed", sdlErrMsg };
+            }
+        }
+
+        size_t size() const noexcept {
+            return items.size();
+        }
+    };
+}
+
+/******************************* sdl2 ttf part. **********************************/
+namespace sdl2 {
+    class SDL2TTF {
+    public:
+        SDL2TTF() {
+            if (TTF_Init() < 0) {
+                const char* ttfErrMsg = TTF_GetError();
+                throw SDL2Exception{ "TTF_Init() failed", ttfErrMsg };
+            }
+        }
+
+        SDL2TTF(const SDL2TTF&) = delete;
+        SDL2TTF& operator=(const SDL2TTF&) = delete;
+        SDL2TTF(SDL2TTF&&) = delete;
+        SDL2TTF& operator=(SDL2TTF&&) = delete;
+
+        ~SDL2TTF() {
+            TTF_Quit();
+        }
+    };
+
+    class Font {
+        TTF_Font* font;
+    public:
+        Font(const std::string& fontFilePath, int pointSize) {
+            if ((font = TTF_OpenFont(fontFilePath.c_str(), pointSize)) == nullptr) {
+                const char* ttfErrMsg = TTF_GetError();
+                throw SDL2Exception{ "TTF_OpenFont() failed", ttfErrMsg };
+            }
+        }
+
+        // the font keeps reading the entry, the AssetPack must outlive it.
+        Font(const PackEntry& entry, int pointSize) {
+            if ((font = TTF_OpenFontRW(entry.rw(), 1, pointSize)) == nullptr) {
+                const char* ttfErrMsg = TTF_GetError();
+                throw SDL2Exception{ "TTF_OpenFontRW() failed", ttfErrMsg };
+            }
+        }
+
+        Font(const Font&) = delete;
+        Font& operator=(const Font&) = delete;
+
+        Font(Font && other) noexcept 
+            : font { other.font }  
+        {
+            other.font = nullptr;
+        }
+
+        Font& operator=(Font&& other) noexcept {
+            if (this != &other) {
+                font = other.font;
+                other.font = nullptr;
+            }
+
+            return *this;
+        }
+
+        ~Font() {
+            if (font) {
+                TTF_CloseFont(font);
+            }
+        }
+
+        TTF_Font* get() {
+            return font;
+        }
+    };
+
+    template <typename ErrorPolicy = ThrowOnError>
+    Surface ttf_render_utf8_blended(Font& font, const std::string& text, SDL_Color fg) {
+        SDL2_PROFILE_SCOPE("ttf_render_utf8_blended");
+        SDL_Surface* surf = TTF_RenderUTF8_Blended(font.get(), text.c_str(), fg);
+        ErrorPolicy::check_ptr(surf, "TTF_RenderUTF8_Blended() failed");
+
+        return Surface{ surf };
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    Surface ttf_render_text_solid(Font& font, const std::string& text, SDL_Color fg) {
+        SDL2_PROFILE_SCOPE("ttf_render_text_solid");
+        SDL_Surface* surf = TTF_RenderText_Solid(font.get(), text.c_str(), fg);
+        ErrorPolicy::check_ptr(surf, "TTF_RenderText_Solid() failed");
+
+        return Surface{ surf };
+    }
+
+    /*
+        rasterizes every (codepoint, size, style) of a font only once into an Atlas,
+        then text is drawn as cached glyph quads through a SpriteBatch, with kerning.
+        glyphs are rendered in white and tinted by the vertex color, needs SDL_ttf 2.0.18 or later.
+    */
+    class GlyphCache {
+        struct Glyph {
+            AtlasRegion region;
+            int offsetX;
+            int advance;
+            bool visible;
+        };
+
+        Renderer& renderer;
+        Font& font;
+        Atlas atlas;
+        std::unordered_map<uint64_t, Glyph> glyphs;
+
+        // invalid sequences give U+FFFD: bad lead or continuation bytes, overlong forms, surrogates, values above U+10FFFF.
+        static uint32_t utf8_next(const char*& p, const char* end) noexcept {
+            unsigned char c = static_cast<unsigned char>(*p++);
+            if (c < 0x80) {
+                return c;
+            }
+
+            int extra = (c >= 0xf8) ? -1 : (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : (c >= 0xc0) ? 1 : -1;
+            if (extra < 0 || end - p < extra) {
+                return 0xfffd;
+            }
+
+            uint32_t codepoint = c & (0x3f >> extra);
+            for (int i = 0; i < extra; ++i) {
+                unsigned char next = static_cast<unsigned char>(*p);
+                if ((next & 0xc0) != 0x80) {
+                    return 0xfffd;
+                }
+
+                codepoint = (codepoint << 6) | (next & 0x3f);
+                ++p;
+            }
+
+            // the smallest codepoint which needs that many extra bytes.
+            const uint32_t minimum[] = { 0, 0x80, 0x800, 0x10000 };
+            if (codepoint < minimum[extra] || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff)) {
+                return 0xfffd;
+            }
+
+            return codepoint;
+        }
+
+        uint64_t glyph_key(uint32_t codepoint) {
+            uint64_t size = static_cast<uint64_t>(TTF_FontHeight(font.get())) & 0xffff;
+            uint64_t style = static_cast<uint64_t>(TTF_GetFontStyle(font.get())) & 0xff;
+            uint64_t outline = static_cast<uint64_t>(TTF_GetFontOutline(font.get())) & 0xff;
+            return (size << 48) | (outline << 40) | (style << 32) | codepoint;
+        }
+
+        const Glyph& glyph(uint32_t codepoint) {
+            uint64_t key = glyph_key(codepoint);
+            auto it = glyphs.find(key);
+            if (it != glyphs.end()) {
+                return it->second;
+            }
+
+            int minX, maxX, minY, maxY, advance;
+            if (TTF_GlyphMetrics32(font.get(), codepoint, &minX, &maxX, &minY, &maxY, &advance) < 0) {
+                const char* ttfErrMsg = TTF_GetError();
+                throw SDL2Exception{ "TTF_GlyphMetrics32() failed", ttfErrMsg };
+            }
+
+            Glyph g = { AtlasRegion{ 0, SDL_Rect{ 0, 0, 0, 0 } }, std::min(0, minX), advance, false };
+
+            // blank glyphs like space only move the pen.
+            if (maxX > minX && maxY > minY) {
+                SDL_Surface* surf = TTF_RenderGlyph32_Blended(font.get(), codepoint, SDL_Color{ 255, 255, 255, 255 });
+                if (surf == nullptr) {
+                    const char* ttfErrMsg = TTF_GetError();
+                    throw SDL2Exception{ "TTF_RenderGlyph32_Blended() failed", ttfErrMsg };
+                }
+
+                Surface surface{ surf };
+                g.region = atlas.add(renderer, surface.get());
+                g.visible = true;
+            }
+
+            return glyphs.emplace(key, g).first->second;
+        }
+    public:
+        GlyphCache(Renderer& _renderer, Font& _font, int pageSize = 512)
+            : renderer{ _renderer }, font{ _font }, atlas{ pageSize, pageSize }, glyphs{}
+        {}
+
+        GlyphCache(const GlyphCache&) = delete;
+        GlyphCache& operator=(const GlyphCache&) = delete;
+
+        ~GlyphCache() {}
+
+        /*
+            emits the quads of an utf8 string into the batch, (x, y) is the top left corner of the first line.
+            '\n' starts a new line. returns the pen position after the last glyph.
+        */
+        SDL_FPoint draw(SpriteBatch& batch, const std::string& text, float x, float y, SDL_Color color) {
+            bool kerning = TTF_GetFontKerning(font.get()) != 0;
+            float lineSkip = static_cast<float>(TTF_FontLineSkip(font.get()));
+            float penX = x;
+            uint32_t prev = 0;
+
+            const char* p = text.data();
+            const char* end = p + text.size();
+            while (p < end) {
+                uint32_t codepoint = utf8_next(p, end);
+                if (codepoint == '\n') {
+                    penX = x;
+                    y += lineSkip;
+                    prev = 0;
+                    continue;
+                }
+
+                if (kerning && prev != 0) {
+                    penX += TTF_GetFontKerningSizeGlyphs32(font.get(), prev, codepoint);
+                }
+
+                const Glyph& g = glyph(codepoint);
+                if (g.visible) {
+                    SDL_FRect dstRect = { penX + g.offsetX, y, static_cast<float>(g.region.rect.w), static_cast<float>(g.region.rect.h) };
+                    batch.draw(atlas, g.region, dstRect, color);
+                }
+
+                penX += g.advance;
+                prev = codepoint;
+            }
+
+            return SDL_FPoint{ penX, y };
+        }
+
+        /*
+            drops every cached glyph, call it after the font size changed a lot to get the atlas memory back.
+            the atlas pages are destroyed, so a SpriteBatch still holding quads of draw() must be flushed before,
+            the second overload does it.
+        */
+        void clear() noexcept {
+            glyphs.clear();
+            atlas.clear();
+        }
+
+        void clear(SpriteBatch& batch) {
+            batch.flush();
+            clear();
+        }
+
+        size_t glyph_count() const noexcept {
+            return glyphs.size();
+        }
+
+        float line_skip() {
+            return static_cast<float>(TTF_FontLineSkip(font.get()));
+        }
+    };
+
+#ifdef SDL2_WRAPPER_PROFILE
+    // draws the totals of the last complete frame, one line per wrapper function or user scope, the slowest first.
+    void profiler_draw_overlay(GlyphCache& glyphCache, SpriteBatch& batch, float x, float y, SDL_Color color) {
+        char line[160];
+
+        for (const auto& s : Profiler::summary()) {
+            snprintf(line, sizeof(line), "%-32s %6llu calls %9.3f ms %10.1f KB",
+                     s.name.c_str(), static_cast<unsigned long long>(s.calls), s.nanoSeconds / 1e6, s.bytes / 1024.0);
+            glyphCache.draw(batch, line, x, y, color);
+            y += glyphCache.line_skip();
+        }
+    }
+#endif
+}
+
+/******************************* sdl2 image part. **********************************/
+namespace sdl2 {
+    template <typename ErrorPolicy = ThrowOnError>
+    Surface img_load(const std::string& filePath) {
+        SDL2_PROFILE_SCOPE("img_load");
+        SDL_Surface* surf = IMG_Load(filePath.c_str());
+        ErrorPolicy::check_ptr(surf, "IMG_Load() failed");
+
+        return Surface{ surf };
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    Surface img_load(const PackEntry& entry) {
+        SDL2_PROFILE_SCOPE("img_load");
+        SDL_Surface* surf = IMG_Load_RW(entry.rw(), 1);
+        ErrorPolicy::check_ptr(surf, "IMG_Load_RW() failed");
+
+        return Surface{ surf };
+    }
+}
+
+/******************************* sdl2 mixer part. **********************************/
+namespace sdl2 {
+    class SDL2Mixer {
+    public:
+        SDL2Mixer() {}
+
+        SDL2Mixer(const SDL2Mixer&) = delete;
+        SDL2Mixer& operator=(const SDL2Mixer&) = delete;
+        SDL2Mixer(SDL2Mixer&&) = delete;
+        SDL2Mixer& operator=(SDL2Mixer&&) = delete;
+
+        ~SDL2Mixer() {
+            Mix_Quit();
+        }
+
+        // this call is optional.
+        int do_mixer_init(int flags) noexcept {
+            return Mix_Init(flags);
+        }
+    };
+
+    class MixOpenAudio {
+    public:
+        MixOpenAudio(int frequency, uint16_t format, int channels, int chunksize) {
+            if (Mix_OpenAudio(frequency, format, channels, chunksize) < 0) {
+                const char* mixErrMsg = Mix_GetError();
+                throw SDL2Exception{ "Mix_OpenAudio() failed", mixErrMsg };
+            }
+        }
+
+        MixOpenAudio(const MixOpenAudio&) = delete;
+        MixOpenAudio& operator=(const MixOpenAudio&) = delete;
+        MixOpenAudio(MixOpenAudio&&) = delete;
+        MixOpenAudio& operator=(MixOpenAudio&&) = delete;
+
+        ~MixOpenAudio() {
+            Mix_CloseAudio();
+        }
+    };
+
+    class MixChunk {
+        Mix_Chunk* chunk;
+    public:
+        MixChunk() : chunk { nullptr } {}
+        MixChunk(Mix_Chunk* _chunk) : chunk{ _chunk } {}
+
+        MixChunk(const MixChunk&) = delete;
+        MixChunk& operator=(const MixChunk&) = delete;
+
+        MixChunk(MixChunk && other) noexcept 
+            : chunk { other.chunk }  
+        {
+            other.chunk = nullptr;
+        }
+
+        MixChunk& operator=(MixChunk&& other) noexcept {
+            if (this != &other) {
+                chunk = other.chunk;
+                other.chunk = nullptr;
+            }
+
+            return *this;
+        }
+
+        ~MixChunk() {
+            if (chunk) {
+                Mix_FreeChunk(chunk);
+            }
+        }
+
+        Mix_Chunk* get() noexcept {
+            return chunk;
+        }
+    };
+
+    template <typename ErrorPolicy = ThrowOnError>
+    SDL_RWops* sdl_rw_from_file(const std::string& file, const std::string& mode) {
+        SDL_RWops* ops = SDL_RWFromFile(file.c_str(), mode.c_str());
+        ErrorPolicy::check_ptr(ops, "SDL_RWFromFile() failed");
+
+        return ops;
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    MixChunk mix_load_wav_rw(SDL_RWops* src, int freeSrc) {
+        SDL2_PROFILE_SCOPE("mix_load_wav_rw");
+        Mix_Chunk* chunk = Mix_LoadWAV_RW(src, freeSrc);
+        ErrorPolicy::check_ptr(chunk, "Mix_LoadWAV_RW() failed");
+
+        return MixChunk{ chunk };
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    MixChunk mix_load_wav_rw(const PackEntry& entry) {
+        return mix_load_wav_rw<ErrorPolicy>(entry.rw(), 1);
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type mix_play_channel(int channel, MixChunk& chunk, int loops) {
+        return ErrorPolicy::check(Mix_PlayChannel(channel, chunk.get(), loops), "Mix_PlayChannel() failed");
+    }
+
+    /*
+        a streamed music track, decoded while it plays instead of all at once like MixChunk.
+        from memory or a PackEntry, the bytes are read during playback, so they must outlive the MixMusic.
+        SDL_mixer plays one music at a time, see MusicPlayer for crossfades and loop points.
+    */
+    class MixMusic {
+        Mix_Music* music;
+    public:
+        MixMusic() : music{ nullptr } {}
+        MixMusic(Mix_Music* _music) : music{ _music } {}
+
+        MixMusic(const std::string& musicFilePath) : music{ Mix_LoadMUS(musicFilePath.c_str()) } {
+            if (music == nullptr) {
+                const char* mixErrMsg = Mix_GetError();
+                throw SDL2Exception{ "Mix_LoadMUS() failed", mixErrMsg };
+            }
+        }
+
+        MixMusic(const void* data, size_t size) : music{ Mix_LoadMUS_RW(sdl_rw_from_const_mem(data, size), 1) } {
+            if (music == nullptr) {
+                const char* mixErrMsg = Mix_GetError();
+                throw SDL2Exception{ "Mix_LoadMUS_RW() failed", mixErrMsg };
+            }
+        }
+
+        MixMusic(const PackEntry& entry) : MixMusic{ entry.data, entry.size } {}
+
+        MixMusic(const MixMusic&) = delete;
+        MixMusic& operator=(const MixMusic&) = delete;
+
+        MixMusic(MixMusic&& other) noexcept
+            : music{ other.music }
+        {
+            other.music = nullptr;
+        }
+
+        MixMusic& operator=(MixMusic&& other) noexcept {
+            if (this != &other) {
+                if (music) {
+                    Mix_FreeMusic(music);
+                }
+
+                music = other.music;
+                other.music = nullptr;
+            }
+
+            return *this;
+        }
+
+        // Mix_FreeMusic() halts the music first if it is playing.
+        ~MixMusic() {
+            if (music) {
+                Mix_FreeMusic(music);
+            }
+        }
+
+        Mix_Music* get() noexcept {
+            return music;
+        }
+
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+        // in seconds, -1 if the decoder doesn't know.
+        double duration() noexcept {
+            return Mix_MusicDuration(music);
+        }
+
+        double position() noexcept {
+            return Mix_GetMusicPosition(music);
+        }
+
+        // the LOOPSTART / LOOPEND tags of the file, -1 if it has none.
+        double tag_loop_start() noexcept {
+            return Mix_GetMusicLoopStartTime(music);
+        }
+
+        double tag_loop_end() noexcept {
+            return Mix_GetMusicLoopEndTime(music);
+        }
+#endif
+    };
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type mix_play_music(MixMusic& music, int loops) {
+        return ErrorPolicy::check(Mix_PlayMusic(music.get(), loops), "Mix_PlayMusic() failed");
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type mix_fade_in_music_pos(MixMusic& music, int loops, int milliSeconds, double position) {
+        return ErrorPolicy::check(Mix_FadeInMusicPos(music.get(), loops, milliSeconds, position), "Mix_FadeInMusicPos() failed");
+    }
+
+    // returns false if no music was playing.
+    inline bool mix_fade_out_music(int milliSeconds) noexcept {
+        return Mix_FadeOutMusic(milliSeconds) != 0;
+    }
+
+    template <typename ErrorPolicy = ThrowOnError>
+    typename ErrorPolicy::result_type mix_set_music_position(double position) {
+        return ErrorPolicy::check(Mix_SetMusicPosition(position), "Mix_SetMusicPosition() failed");
+    }
+
+    /*
+        plays MixMusic tracks, with crossfades and loop points. call update() once per frame.
+        SDL_mixer can't play 2 musics at once, so a crossfade fades the current track out during the first half,
+        then fades the next one in during the second half.
+        a loop point jumps back to loopStart when the position passes loopEnd, checked in update(),
+        so it is as precise as the frame rate, use the LOOPSTART / LOOPEND tags of the file for sample exact loops.
+        the tracks are not owned, they must outlive their playback.
+    */
+    class MusicPlayer {
+        MixMusic* current;
+        MixMusic* next;
+        int nextLoops;
+        int fadeInMilliSeconds;
+        double nextPosition;
+        double loopStart;
+        double loopEnd;
+        double nextLoopStart;
+        double nextLoopEnd;
+    public:
+        MusicPlayer()
+            : current{ nullptr }, next{ nullptr }, nextLoops{ -1 }, fadeInMilliSeconds{ 0 }, nextPosition{ 0 },
+              loopStart{ 0 }, loopEnd{ -1 }, nextLoopStart{ 0 }, nextLoopEnd{ -1 } {}
+
+        MusicPlayer(const MusicPlayer&) = delete;
+        MusicPlayer& operator=(const MusicPlayer&) = delete;
+
+        ~MusicPlayer() {}
+
+        // loops -1 means forever, the loop points are reset.
+        void play(MixMusic& music, int loops = -1, int fadeMilliSeconds = 0, double position = 0) {
+            next = nullptr;
+            current = &music;
+            loopEnd = -1;
+            mix_fade_in_music_pos(music, loops, fadeMilliSeconds, position);
+        }
+
+        void crossfade(MixMusic& music, int milliSeconds, int loops = -1, double position = 0) {
+            if (current == nullptr || !mix_fade_out_music(milliSeconds / 2)) {
+                play(music, loops, milliSeconds / 2, position);
+                return;
+            }
+
+            next = &music;
+            nextLoops = loops;
+            nextLoopEnd = -1;
+            nextPosition = position;
+            fadeInMilliSeconds = milliSeconds / 2;
+        }
+
+        void stop(int fadeMilliSeconds = 0) noexcept {
+            next = nullptr;
+            if (fadeMilliSeconds > 0) {
+                mix_fade_out_music(fadeMilliSeconds);
+            }
+            else {
+                Mix_HaltMusic();
+            }
+
+            current = nullptr;
+        }
+
+        void seek(double position) {
+            mix_set_music_position(position);
+        }
+
+        void pause() noexcept {
+            Mix_PauseMusic();
+        }
+
+        void resume() noexcept {
+            Mix_ResumeMusic();
+        }
+
+        // in seconds, loopEnd -1 turns the loop off. during a crossfade they apply to the next track.
+        void set_loop_points(double _loopStart, double _loopEnd) noexcept {
+            if (next) {
+                nextLoopStart = _loopStart;
+                nextLoopEnd = _loopEnd;
+            }
+            else {
+                loopStart = _loopStart;
+                loopEnd = _loopEnd;
+            }
+        }
+
+        void update() {
+            if (next && !Mix_PlayingMusic()) {
+                MixMusic* music = next;
+                play(*music, nextLoops, fadeInMilliSeconds, nextPosition);
+                loopStart = nextLoopStart;
+                loopEnd = nextLoopEnd;
+                return;
+            }
+
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+            if (current && next == nullptr && loopEnd > loopStart && current->position() >= loopEnd) {
+                seek(loopStart);
+            }
+#endif
+        }
+
+        MixMusic* get_current() noexcept {
+            return current;
+        }
+
+        bool crossfading() const noexcept {
+            return next != nullptr;
+        }
+    };
+
+    /*
+        a bounded lock-free queue for many producers and one consumer (D. Vyukov's bounded MPMC queue),
+        push() and pop() never block and never allocate, push() returns false when the queue is full.
+        pop() is wait-free, it runs on the audio thread. push() is only lock-free, not wait-free:
+        producers racing for the same cell retry their CAS, one of them always wins, a given one may retry
+        as many times as the others push meanwhile.
+    */
+    template <typename T>
+    class CommandQueue {
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        size_t mask;
+        std::atomic<size_t> enqueuePos;
+        std::atomic<size_t> dequeuePos;
+    public:
+        // capacity is rounded up to a power of 2.
+        CommandQueue(size_t capacity) : cells{}, mask{ 0 }, enqueuePos{ 0 }, dequeuePos{ 0 } {
+            size_t size = 2;
+            while (size < capacity) {
+                size *= 2;
+            }
+
+            cells.reset(new Cell[size]);
+            mask = size - 1;
+            for (size_t i = 0; i < size; ++i) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        CommandQueue(const CommandQueue&) = delete;
+        CommandQueue& operator=(const CommandQueue&) = delete;
+
+        ~CommandQueue() {}
+
+        bool push(const T& value) noexcept {
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            while (true) {
+                Cell& cell = cells[pos & mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+                if (diff == 0) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.value = value;
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0) {
+                    return false;
+                }
+                else {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool pop(T& value) noexcept {
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0) {
+                return false;
+            }
+
+            // one consumer only, so nobody else moves dequeuePos.
+            value = cell.value;
+            dequeuePos.store(pos + 1, std::memory_order_relaxed);
+            cell.sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    namespace kernels {
+        // dst[2i] += src[2i] * left, dst[2i + 1] += src[2i + 1] * right, for n interleaved stereo frames.
+        inline void mix_stereo_scalar(const int16_t* src, float* dst, int n, float left, float right) noexcept {
+            for (int i = 0; i < n; ++i) {
+                dst[2 * i] += src[2 * i] * left;
+                dst[2 * i + 1] += src[2 * i + 1] * right;
+            }
+        }
+
+        // out = saturate(out + acc), for n samples.
+        inline void mix_store_scalar(const float* acc, int16_t* out, int n) noexcept {
+            for (int i = 0; i < n; ++i) {
+                float v = out[i] + acc[i];
+                v = v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v);
+                out[i] = static_cast<int16_t>(std::lrint(v));
+            }
+        }
+
+#ifdef SDL2_WRAPPER_SSE2
+        inline void mix_stereo_sse2(const int16_t* src, float* dst, int n, float left, float right) noexcept {
+            const __m128 gain = _mm_setr_ps(left, right, left, right);
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+                // sign extends the 16 bits samples to 32 bits.
+                __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+                __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+                _mm_storeu_ps(dst + 2 * i, _mm_add_ps(_mm_loadu_ps(dst + 2 * i), _mm_mul_ps(lo, gain)));
+                _mm_storeu_ps(dst + 2 * i + 4, _mm_add_ps(_mm_loadu_ps(dst + 2 * i + 4), _mm_mul_ps(hi, gain)));
+            }
+
+            mix_stereo_scalar(src + 2 * i, dst + 2 * i, n - i, left, right);
+        }
+
+        // _mm_cvtps_epi32 rounds instead of truncating, packs saturates.
+        inline void mix_store_sse2(const float* acc, int16_t* out, int n) noexcept {
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+                __m128 lo = _mm_add_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(o, o), 16)), _mm_loadu_ps(acc + i));
+                __m128 hi = _mm_add_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(o, o), 16)), _mm_loadu_ps(acc + i + 4));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+            }
+
+            mix_store_scalar(acc + i, out + i, n - i);
+        }
+#endif
+    }
+
+    typedef uint32_t VoiceId;
+
+    struct VoiceMixerStats {
+        uint32_t activeVoices;
+        uint64_t stolenVoices;
+        uint64_t droppedVoices;
+    };
+
+    /*
+        a software mixer for many voices, on top of SDL_mixer's output (Mix_SetPostMix()), it needs AUDIO_S16SYS stereo.
+        any thread calls play(), stop() and set_volume(), they only push commands to a lock-free queue,
+        the audio thread applies them and mixes the voices with SSE2 gain / pan kernels.
+        when all the voices are busy, play() steals the one with the lowest priority, if it isn't higher than the new one.
+        the chunks are not owned, they must outlive their voices.
+
+            sdl2::MixOpenAudio moa{ 48000, MIX_DEFAULT_FORMAT, 2, 1024 };
+            sdl2::VoiceMixer mixer{ 256 };
+            sdl2::VoiceId id = mixer.play(chunk, 1.0f, -0.5f, 10);
+
+        with postMix false, nothing is hooked, call mix() from your own audio callback.
+    */
+    class VoiceMixer {
+        enum class CommandKind : uint8_t {
+            PLAY, STOP, SET_VOLUME, STOP_ALL
+        };
+
+        struct Command {
+            CommandKind kind;
+            VoiceId id;
+            const int16_t* samples;
+            uint32_t frames;
+            int loops;
+            int priority;
+            float left;
+            float right;
+        };
+
+        struct Voice {
+            VoiceId id;
+            const int16_t* samples;
+            uint32_t frames;
+            uint32_t position;
+            int loops;
+            int priority;
+            float left;
+            float right;
+        };
+
+        static const int BLOCK_FRAMES = 1024;
+
+        CommandQueue<Command> commands;
+        std::vector<Voice> voices;
+        size_t activeNum;
+        std::vector<float> accumulator;
+        std::atomic<VoiceId> nextId;
+        std::atomic<uint32_t> activeVoices;
+        std::atomic<uint64_t> stolenVoices;
+        std::atomic<uint64_t> droppedVoices;
+        bool postMix;
+        void (*mixStereo)(const int16_t*, float*, int, float, float);
+        void (*mixStore)(const float*, int16_t*, int);
+
+        static void post_mix(void* udata, uint8_t* stream, int len) {
+            static_cast<VoiceMixer*>(udata)->mix(reinterpret_cast<int16_t*>(stream), len / static_cast<int>(2 * sizeof(int16_t)));
+        }
+
+        // constant power pan, -1 is left, 1 is right.
+        static void gains(float volume, float pan, float& left, float& right) noexcept {
+            float angle = (std::min(std::max(pan, -1.0f), 1.0f) + 1.0f) * 0.785398163f;
+            left = volume * std::cos(angle);
+            right = volume * std::sin(angle);
+        }
+
+        Voice* find(VoiceId id) noexcept {
+            for (size_t i = 0; i < activeNum; ++i) {
+                if (voices[i].id == id) {
+                    return &voices[i];
+                }
+            }
+
+            return nullptr;
+        }
+
+        void remove(size_t index) noexcept {
+            voices[index] = voices[--activeNum];
+        }
+
+        void start(const Command& command) noexcept {
+            Voice voice = { command.id, command.samples, command.frames, 0, command.loops, command.priority, command.left, command.right };
+            if (activeNum < voices.size()) {
+                voices[activeNum++] = voice;
+                return;
+            }
+
+            // the lowest priority loses, the oldest one (the most played) among equals.
+            size_t victim = 0;
+            for (size_t i = 1; i < activeNum; ++i) {
+                const Voice& v = voices[i];
+                const Voice& best = voices[victim];
+                if (v.priority < best.priority || (v.priority == best.priority && v.position > best.position)) {
+                    victim = i;
+                }
+            }
+
+            if (voices[victim].priority > command.priority) {
+                droppedVoices.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            voices[victim] = voice;
+            stolenVoices.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void apply_commands() noexcept {
+            Command command;
+            while (commands.pop(command)) {
+                switch (command.kind) {
+                case CommandKind::PLAY:
+                    start(command);
+                    break;
+                case CommandKind::STOP:
+                    for (size_t i = 0; i < activeNum; ++i) {
+                        if (voices[i].id == command.id) {
+                            remove(i);
+                            break;
+                        }
+                    }
+                    break;
+                case CommandKind::SET_VOLUME:
+                    if (Voice* voice = find(command.id)) {
+                        voice->left = command.left;
+                        voice->right = command.right;
+                    }
+                    break;
+                case CommandKind::STOP_ALL:
+                    activeNum = 0;
+                    break;
+                }
+            }
+        }
+
+        // mixes frameNum frames of the voice into acc, returns false when it ended.
+        bool mix_voice(Voice& voice, float* acc, int frameNum) noexcept {
+            int done = 0;
+            while (done < frameNum) {
+                int n = static_cast<int>(std::min<uint32_t>(voice.frames - voice.position, static_cast<uint32_t>(frameNum - done)));
+                mixStereo(voice.samples + 2 * static_cast<size_t>(voice.position), acc + 2 * done, n, voice.left, voice.right);
+                voice.position += static_cast<uint32_t>(n);
+                done += n;
+
+                if (voice.position == voice.frames) {
+                    if (voice.loops == 0) {
+                        return false;
+                    }
+
+                    if (voice.loops > 0) {
+                        --voice.loops;
+                    }
+
+                    voice.position = 0;
+                }
+            }
+
+            return true;
+        }
+
+        bool push(const Command& command) noexcept {
+            if (commands.push(command)) {
+                return true;
+            }
+
+            droppedVoices.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    public:
+        VoiceMixer(size_t maxVoices = 256, size_t commandCapacity = 1024, bool _postMix = true)
+            : commands{ commandCapacity }, voices(std::max<size_t>(maxVoices, 1)), activeNum{ 0 }, accumulator(2 * BLOCK_FRAMES),
+              nextId{ 1 }, activeVoices{ 0 }, stolenVoices{ 0 }, droppedVoices{ 0 }, postMix{ _postMix },
+              mixStereo{ kernels::mix_stereo_scalar }, mixStore{ kernels::mix_store_scalar }
+        {
+            int frequency = 0;
+            uint16_t format = 0;
+            int channels = 0;
+            if (Mix_QuerySpec(&frequency, &format, &channels) == 0) {
+                const char* mixErrMsg = Mix_GetError();
+                throw SDL2Exception{ "Mix_QuerySpec() failed", mixErrMsg };
+            }
+
+            if (format != AUDIO_S16SYS || channels != 2) {
+                throw SDL2Exception{ "VoiceMixer() failed", "the audio device must be AUDIO_S16SYS stereo" };
+            }
+
+#ifdef SDL2_WRAPPER_SSE2
+            if (SDL_HasSSE2()) {
+                mixStereo = kernels::mix_stereo_sse2;
+                mixStore = kernels::mix_store_sse2;
+            }
+#endif
+
+            if (postMix) {
+                Mix_SetPostMix(post_mix, this);
+            }
+        }
+
+        VoiceMixer(const VoiceMixer&) = delete;
+        VoiceMixer& operator=(const VoiceMixer&) = delete;
+
+        // Mix_SetPostMix() locks the audio device, the callback is not running once it returns.
+        ~VoiceMixer() {
+            if (postMix) {
+                Mix_SetPostMix(nullptr, nullptr);
+            }
+        }
+
+        /*
+            volume is 0 to 1, pan -1 (left) to 1 (right), loops -1 means forever.
+            returns 0 if the command queue is full.
+        */
+        VoiceId play(MixChunk& chunk, float volume = 1.0f, float pan = 0.0f, int priority = 0, int loops = 0) noexcept {
+            Mix_Chunk* c = chunk.get();
+            uint32_t frames = c ? c->alen / static_cast<uint32_t>(2 * sizeof(int16_t)) : 0;
+            if (frames == 0) {
+                return 0;
+            }
+
+            VoiceId id = nextId.fetch_add(1, std::memory_order_relaxed);
+            if (id == 0) {
+                id = nextId.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            Command command = { CommandKind::PLAY, id, reinterpret_cast<const int16_t*>(c->abuf), frames, loops, priority, 0, 0 };
+            gains(volume, pan, command.left, command.right);
+            return push(command) ? id : 0;
+        }
+
+        bool stop(VoiceId id) noexcept {
+            Command command = { CommandKind::STOP, id, nullptr, 0, 0, 0, 0, 0 };
+            return push(command);
+        }
+
+        bool stop_all() noexcept {
+            Command command = { CommandKind::STOP_ALL, 0, nullptr, 0, 0, 0, 0, 0 };
+            return push(command);
+        }
+
+        bool set_volume(VoiceId id, float volume, float pan = 0.0f) noexcept {
+            Command command = { CommandKind::SET_VOLUME, id, nullptr, 0, 0, 0, 0, 0 };
+            gains(volume, pan, command.left, command.right);
+            return push(command);
+        }
+
+        // the audio callback side, adds the voices to frameNum interleaved stereo frames.
+        void mix(int16_t* stream, int frameNum) noexcept {
+            apply_commands();
+
+            for (int begin = 0; begin < frameNum; begin += BLOCK_FRAMES) {
+                int n = std::min(int{ BLOCK_FRAMES }, frameNum - begin);
+                std::fill(accumulator.begin(), accumulator.begin() + 2 * n, 0.0f);
+
+                for (size_t i = 0; i < activeNum;) {
+                    if (mix_voice(voices[i], accumulator.data(), n)) {
+                        ++i;
+                    }
+                    else {
+                        remove(i);
+                    }
+                }
+
+                mixStore(accumulator.data(), stream + 2 * begin, 2 * n);
+            }
+
+            activeVoices.store(static_cast<uint32_t>(activeNum), std::memory_order_relaxed);
+        }
+
+        VoiceMixerStats get_stats() const noexcept {
+            VoiceMixerStats stats;
+            stats.activeVoices = activeVoices.load(std::memory_order_relaxed);
+            stats.stolenVoices = stolenVoices.load(std::memory_order_relaxed);
+            stats.droppedVoices = droppedVoices.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+        size_t max_voices() const noexcept {
+            return voices.size();
+        }
+    };
+}
+
+
+/******************************* sdl2 asset part. **********************************/
+namespace sdl2 {
+    /*
+        a fixed set of worker threads running submitted tasks in FIFO order.
+        0 threads means one less than the cpu count, but at least 1.
+    */
+    class ThreadPool {
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool stopping;
+
+        void work() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock{ mutex };
+                    cond.wait(lock, [this] { return stopping || !tasks.empty(); });
+                    if (tasks.empty()) {
+                        return;
+                    }
+
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+
+                task();
+            }
+        }
+    public:
+        ThreadPool(unsigned threadNum = 0) : workers{}, tasks{}, mutex{}, cond{}, stopping{ false } {
+            if (threadNum == 0) {
+                threadNum = static_cast<unsigned>(std::max(1, SDL_GetCPUCount() - 1));
+            }
+
+            for (unsigned i = 0; i < threadNum; ++i) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ThreadPool(ThreadPool&&) = delete;
+        ThreadPool& operator=(ThreadPool&&) = delete;
+
+        // the tasks already submitted still run before the workers exit.
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                stopping = true;
+            }
+
+            cond.notify_all();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        template <typename F, typename R = decltype(std::declval<F&>()())>
+        std::future<R> submit(F f) {
+            // std::function needs a copyable target, so the task is shared.
+            std::shared_ptr<std::packaged_task<R()>> task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+            std::future<R> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                tasks.emplace_back([task] { (*task)(); });
+            }
+
+            cond.notify_one();
+            return result;
+        }
+
+        size_t size() const noexcept {
+            return workers.size();
+        }
+    };
+
+    /*
+        a texture that AssetLoader is still loading, it becomes ready after an AssetLoader::pump() uploaded it.
+        only use it on the render thread.
+    */
+    class TextureHandle {
+        friend class AssetLoader;
+
+        struct Slot {
+            Texture texture;
+            bool ready;
+            std::exception_ptr error;
+        };
+
+        std::shared_ptr<Slot> slot;
+    public:
+        TextureHandle() : slot{} {}
+
+        bool ready() const noexcept {
+            return slot && slot->ready;
+        }
+
+        bool failed() const noexcept {
+            return slot && slot->error;
+        }
+
+        // rethrows the loading error, if any. the texture is empty before ready() is true.
+        Texture& get() {
+            if (!slot) {
+                throw SDL2Exception{ "TextureHandle::get() failed", "the handle was not returned by AssetLoader" };
+            }
+
+            if (slot->error) {
+                std::rethrow_exception(slot->error);
+            }
+
+            return slot->texture;
+        }
+    };
+
+    /*
+        decodes images and sounds on a thread pool, then uploads the images as textures
+        on the render thread within a per-frame time / byte budget, see pump().
+        fonts are not supported, SDL_ttf is not thread safe.
+    */
+    class AssetLoader {
+        struct Upload {
+            std::shared_ptr<TextureHandle::Slot> slot;
+            std::future<Surface> surface;
+        };
+
+        ThreadPool pool;
+        std::deque<Upload> uploads;
+
+        // uploads the front of the queue, its surface must be ready. returns the uploaded bytes.
+        size_t upload_front(Renderer& renderer) {
+            Upload upload = std::move(uploads.front());
+            uploads.pop_front();
+
+            size_t bytes = 0;
+            try {
+                Surface surface = upload.surface.get();
+                bytes = static_cast<size_t>(surface->h) * surface->pitch;
+                upload.slot->texture = sdl_create_texture_from_surface(renderer, surface.get());
+                upload.slot->ready = true;
+            }
+            catch (...) {
+                upload.slot->error = std::current_exception();
+            }
+
+            return bytes;
+        }
+    public:
+        AssetLoader(unsigned threadNum = 0) : pool{ threadNum }, uploads{} {}
+
+        AssetLoader(const AssetLoader&) = delete;
+        AssetLoader& operator=(const AssetLoader&) = delete;
+
+        ~AssetLoader() {}
+
+        std::future<Surface> load_surface(const std::string& filePath) {
+            return pool.submit([filePath] { return img_load(filePath); });
+        }
+
+        std::future<Surface> load_bmp(const std::string& bmpFilePath) {
+            return pool.submit([bmpFilePath] {
+                SDL_Surface* surf = SDL_LoadBMP(bmpFilePath.c_str());
+                ThrowOnError::check_ptr(surf, "SDL_LoadBMP() failed");
+                return Surface{ surf };
+            });
+        }
+
+        // needs an opened audio device, Mix_LoadWAV_RW() converts to its format.
+        std::future<MixChunk> load_chunk(const std::string& filePath) {
+            return pool.submit([filePath] { return mix_load_wav_rw(sdl_rw_from_file(filePath, "rb"), 1); });
+        }
+
+        TextureHandle load_texture(const std::string& filePath) {
+            TextureHandle handle;
+            handle.slot = std::make_shared<TextureHandle::Slot>();
+            handle.slot->ready = false;
+
+            Upload upload = { handle.slot, load_surface(filePath) };
+            uploads.push_back(std::move(upload));
+            return handle;
+        }
+
+        // queues every file at once, so all the workers decode in parallel.
+        std::vector<TextureHandle> preload(const std::vector<std::string>& manifest) {
+            std::vector<TextureHandle> handles;
+            handles.reserve(manifest.size());
+
+            for (const auto& filePath : manifest) {
+                handles.push_back(load_texture(filePath));
+            }
+
+            return handles;
+        }
+
+        /*
+            call it once per frame on the render thread. uploads the decoded textures in the order they were requested,
+            until maxMilliSeconds or maxBytes is used up. at least one texture is uploaded if one is decoded,
+            so a texture bigger than the budget doesn't block the queue.
+        */
+        void pump(Renderer& renderer, double maxMilliSeconds, size_t maxBytes = SIZE_MAX) {
+            uint64_t begin = SDL_GetPerformanceCounter();
+            uint64_t maxTicks = static_cast<uint64_t>(maxMilliSeconds * SDL_GetPerformanceFrequency() / 1000.0);
+            size_t bytes = 0;
+
+            while (!uploads.empty() && uploads.front().surface.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                bytes += upload_front(renderer);
+
+                if (bytes >= maxBytes || SDL_GetPerformanceCounter() - begin >= maxTicks) {
+                    break;
+                }
+            }
+        }
+
+        // blocks until every requested texture is uploaded, for loading screens and startup.
+        void finish(Renderer& renderer) {
+            while (!uploads.empty()) {
+                uploads.front().surface.wait();
+                upload_front(renderer);
+            }
+        }
+
+        size_t pending() const noexcept {
+            return uploads.size();
+        }
+    };
+
+    /*
+        loads every resource only once and shares it, keyed by path (and point size for fonts, renderer for textures).
+        the memory used is estimated from the pixel / sample sizes, when it goes over the budget
+        the least recently used entries nobody else holds any more are evicted.
+        eviction only happens when something is loaded or trim() is called, not when a handle is released.
+    */
+    class ResourceCache {
+        struct Entry {
+            std::shared_ptr<void> resource;
+            size_t bytes;
+            std::list<std::string>::iterator lruPos;
+        };
+
+        std::unordered_map<std::string, Entry> entries;
+        std::list<std::string> lru;     // the most recently used first.
+        size_t budget;
+        size_t used;
+
+        template <typename T>
+        std::shared_ptr<T> find(const std::string& key) {
+            auto it = entries.find(key);
+            if (it == entries.end()) {
+                return std::shared_ptr<T>{};
+            }
+
+            lru.splice(lru.begin(), lru, it->second.lruPos);
+            return std::static_pointer_cast<T>(it->second.resource);
+        }
+
+        template <typename T>
+        std::shared_ptr<T> insert(const std::string& key, std::shared_ptr<T> resource, size_t bytes) {
+            lru.push_front(key);
+            Entry entry = { resource, bytes, lru.begin() };
+            entries.emplace(key, entry);
+            used += bytes;
+
+            trim();
+            return resource;
+        }
+
+        void erase(std::unordered_map<std::string, Entry>::iterator it) {
+            used -= it->second.bytes;
+            lru.erase(it->second.lruPos);
+            entries.erase(it);
+        }
+    public:
+        ResourceCache(size_t budgetBytes) : entries{}, lru{}, budget{ budgetBytes }, used{ 0 } {}
+
+        ResourceCache(const ResourceCache&) = delete;
+        ResourceCache& operator=(const ResourceCache&) = delete;
+
+        ~ResourceCache() {}
+
+        std::shared_ptr<Surface> surface(const std::string& filePath) {
+            std::string key = "surface:" + filePath;
+            std::shared_ptr<Surface> cached = find<Surface>(key);
+            if (cached) {
+                return cached;
+            }
+
+            std::shared_ptr<Surface> surface = std::make_shared<Surface>(img_load(filePath));
+            return insert(key, surface, static_cast<size_t>((*surface)->h) * (*surface)->pitch);
+        }
+
+        std::shared_ptr<Texture> texture(Renderer& renderer, const std::string& filePath) {
+            std::string key = "texture:" + std::to_string(reinterpret_cast<uintptr_t>(renderer.get())) + ":" + filePath;
+            std::shared_ptr<Texture> cached = find<Texture>(key);
+            if (cached) {
+                return cached;
+            }
+
+            Surface surface = img_load(filePath);
+            std::shared_ptr<Texture> texture = std::make_shared<Texture>(sdl_create_texture_from_surface(renderer, surface.get()));
+
+            uint32_t format;
+            int w, h;
+            sdl_query_texture(*texture, &format, nullptr, &w, &h);
+            return insert(key, texture, static_cast<size_t>(w) * h * SDL_BYTESPERPIXEL(format));
+        }
+
+        // a font costs about its file size, FreeType keeps the whole file in memory.
+        std::shared_ptr<Font> font(const std::string& fontFilePath, int pointSize) {
+            std::string key = "font:" + std::to_string(pointSize) + ":" + fontFilePath;
+            std::shared_ptr<Font> cached = find<Font>(key);
+            if (cached) {
+                return cached;
+            }
+
+            std::shared_ptr<Font> font = std::make_shared<Font>(fontFilePath, pointSize);
+
+            SDL_RWops* ops = SDL_RWFromFile(fontFilePath.c_str(), "rb");
+            Sint64 size = ops ? SDL_RWsize(ops) : 0;
+            if (ops) {
+                SDL_RWclose(ops);
+            }
+
+            return insert(key, font, size > 0 ? static_cast<size_t>(size) : 0);
+        }
+
+        std::shared_ptr<MixChunk> chunk(const std::string& filePath) {
+            std::string key = "chunk:" + filePath;
+            std::shared_ptr<MixChunk> cached = find<MixChunk>(key);
+            if (cached) {
+                return cached;
+            }
+
+            std::shared_ptr<MixChunk> chunk = std::make_shared<MixChunk>(mix_load_wav_rw(sdl_rw_from_file(filePath, "rb"), 1));
+            return insert(key, chunk, chunk->get()->alen);
+        }
+
+        // evicts the unreferenced entries, least recently used first, until the budget is met.
+        void trim() {
+            auto pos = lru.end();
+            while (used > budget && pos != lru.begin()) {
+                --pos;
+                auto it = entries.find(*pos);
+                if (it->second.resource.use_count() == 1) {
+                    auto next = std::next(pos);
+                    erase(it);
+                    pos = next;
+                }
+            }
+        }
+
+        // evicts every unreferenced entry, whatever the budget is.
+        void purge() {
+            for (auto it = entries.begin(); it != entries.end(); ) {
+                auto next = std::next(it);
+                if (it->second.resource.use_count() == 1) {
+                    erase(it);
+                }
+
+                it = next;
+            }
+        }
+
+        void set_budget(size_t budgetBytes) {
+            budget = budgetBytes;
+            trim();
+        }
+
+        size_t get_budget() const noexcept {
+            return budget;
+        }
+
+        size_t used_bytes() const noexcept {
+            return used;
+        }
+
+        size_t size() const noexcept {
+            return entries.size();
+        }
+    };
+
+    /*
+        an on disk cache of decoded images, already converted to the renderer's texture format.
+        a hit maps the blob and uploads it as is, skipping the decoding and the conversion.
+        every source path has one entry per format, named after the hash of the path,
+        the entry keeps the FNV-1a hash of the source content, so a changed source is decoded again and replaces it.
+        the blobs are in the native byte order, the cache is meant for the machine that wrote it.
+    */
+#ifndef SDL2_WRAPPER_NO_MAPPED_FILE
+    struct TextureDiskCacheStats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t stale;
+    };
+
+    class TextureDiskCache {
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t format;
+            uint64_t contentHash;
+            uint32_t width;
+            uint32_t height;
+            uint32_t pitch;
+            uint32_t blend;
+        };
+
+        static const uint32_t VERSION = 1;
+
+        std::string cacheDir;
+        TextureDiskCacheStats stats;
+
+        static uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t hash = 14695981039346656037ull) noexcept {
+            for (size_t i = 0; i < size; ++i) {
+                hash = (hash ^ data[i]) * 1099511628211ull;
+            }
+
+            return hash;
+        }
+
+        static bool is_magic(const char* magic) noexcept {
+            return memcmp(magic, "SDL2TEXC", 8) == 0;
+        }
+
+        // the first 32 bits format with alpha the renderer supports, images with and without alpha share it.
+        static uint32_t native_format(Renderer& renderer) noexcept {
+            SDL_RendererInfo info;
+            if (SDL_GetRendererInfo(renderer.get(), &info) == 0) {
+                for (uint32_t i = 0; i < info.num_texture_formats; ++i) {
+                    uint32_t format = info.texture_formats[i];
+                    if (!SDL_ISPIXELFORMAT_FOURCC(format) && SDL_BYTESPERPIXEL(format) == 4 && SDL_ISPIXELFORMAT_ALPHA(format)) {
+                        return format;
+                    }
+                }
+            }
+
+            return SDL_PIXELFORMAT_ARGB8888;
+        }
+
+        static Texture upload(Renderer& renderer, uint32_t format, int w, int h, const void* pixels, int pitch, bool blend) {
+            SDL2_PROFILE_UPLOAD("TextureDiskCache::upload", static_cast<uint64_t>(pitch) * h);
+            Texture texture{ SDL_CreateTexture(renderer.get(), format, SDL_TEXTUREACCESS_STATIC, w, h) };
+            if (texture.get() == nullptr) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_CreateTexture() failed", sdlErrMsg };
+            }
+
+            sdl_update_texture(texture, nullptr, pixels, pitch);
+            if (blend) {
+                SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND);
+            }
+
+            return texture;
+        }
+
+        // written to a temporary file first, so a crash never leaves a truncated entry behind.
+        void write_entry(const std::string& entryPath, const Header& header, SDL_Surface* surface) {
+            std::string tempPath = entryPath + ".tmp";
+            SDL_RWops* ops = SDL_RWFromFile(tempPath.c_str(), "wb");
+            if (ops == nullptr) {
+                return;
+            }
+
+            bool ok = SDL_RWwrite(ops, &header, sizeof(header), 1) == 1;
+            for (int y = 0; ok && y < surface->h; ++y) {
+                ok = SDL_RWwrite(ops, static_cast<const uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch, header.pitch, 1) == 1;
+            }
+
+            ok = SDL_RWclose(ops) == 0 && ok;
+            std::remove(entryPath.c_str());
+            if (!ok || std::rename(tempPath.c_str(), entryPath.c_str()) != 0) {
+                std::remove(tempPath.c_str());
+            }
+        }
+    public:
+        // the directory is created if it doesn't exist.
+        TextureDiskCache(const std::string& _cacheDir) : cacheDir{ _cacheDir }, stats{} {
+#ifdef _WIN32
+            CreateDirectoryA(cacheDir.c_str(), nullptr);
+#else
+            mkdir(cacheDir.c_str(), 0755);
+#endif
+        }
+
+        TextureDiskCache(const TextureDiskCache&) = delete;
+        TextureDiskCache& operator=(const TextureDiskCache&) = delete;
+
+        ~TextureDiskCache() {}
+
+        std::string entry_path(const std::string& imagePath, uint32_t format) const {
+            uint64_t pathHash = fnv1a(reinterpret_cast<const uint8_t*>(imagePath.data()), imagePath.size());
+            char name[64];
+            snprintf(name, sizeof(name), "/%016llx_%08x.tex", static_cast<unsigned long long>(pathHash), format);
+            return cacheDir + name;
+        }
+
+        std::string entry_path(Renderer& renderer, const std::string& imagePath) const {
+            return entry_path(imagePath, native_format(renderer));
+        }
+
+        Texture load(Renderer& renderer, const std::string& imagePath) {
+            SDL2_PROFILE_SCOPE("TextureDiskCache::load");
+
+            uint32_t format = native_format(renderer);
+            std::string entryPath = entry_path(imagePath, format);
+            uint64_t contentHash = 0;
+            {
+                MappedFile source{ imagePath };
+                contentHash = fnv1a(source.get(), source.get_size());
+            }
+
+            // a missing entry is a normal miss, not an error.
+            SDL_RWops* probe = SDL_RWFromFile(entryPath.c_str(), "rb");
+            if (probe) {
+                SDL_RWclose(probe);
+
+                MappedFile entry{ entryPath };
+                Header header;
+                if (entry.get_size() >= sizeof(Header)) {
+                    memcpy(&header, entry.get(), sizeof(Header));
+                    bool valid = is_magic(header.magic) && header.version == VERSION && header.format == format
+                        && entry.get_size() == sizeof(Header) + static_cast<size_t>(header.pitch) * header.height;
+
+                    if (valid && header.contentHash == contentHash) {
+                        ++stats.hits;
+                        return upload(renderer, format, static_cast<int>(header.width), static_cast<int>(header.height),
+                                      entry.get() + sizeof(Header), static_cast<int>(header.pitch), header.blend != 0);
+                    }
+                }
+
+                ++stats.stale;
+            }
+
+            ++stats.misses;
+            Surface decoded = img_load(imagePath);
+            bool blend = SDL_ISPIXELFORMAT_ALPHA(decoded->format->format) || SDL_HasColorKey(decoded.get());
+            Surface converted{ SDL_ConvertSurfaceFormat(decoded.get(), format, 0) };
+            if (converted.get() == nullptr) {
+                const char* sdlErrMsg = SDL_GetError();
+                throw SDL2Exception{ "SDL_ConvertSurfaceFormat() failed", sdlErrMsg };
+            }
+
+            Header header = {};
+            memcpy(header.magic, "SDL2TEXC", 8);
+            header.version = VERSION;
+            header.format = format;
+            header.contentHash = contentHash;
+            header.width = static_cast<uint32_t>(converted->w);
+            header.height = static_cast<uint32_t>(converted->h);
+            header.pitch = static_cast<uint32_t>(converted->w * SDL_BYTESPERPIXEL(format));
+            header.blend = blend ? 1 : 0;
+            write_entry(entryPath, header, converted.get());
+
+            return upload(renderer, format, converted->w, converted->h, converted->pixels, converted->pitch, blend);
+        }
+
+        const TextureDiskCacheStats& get_stats() const noexcept {
+            return stats;
+        }
+
+        void reset_stats() noexcept {
+            stats = TextureDiskCacheStats{};
+        }
+    };
+#endif
+}
+
+
+/******************************* sdl2 surface kernels part. **********************************/
+namespace sdl2 {
+    /*
+        row kernels of the software path, on 32 bits pixels with the alpha in the top byte (ARGB8888 / ABGR8888).
+        the straight alpha blend is the one of SDL2's C blitter (BlitRGBtoRGBPixelAlpha in SDL_blit_A.c):
+
+            sA == 0 keeps dst, sA == 255 copies src, else
+            dC = dC + ((sC - dC) * sA >> 8)
+            dA = sA + (dA * (255 - sA) >> 8)
+
+        SSE2 and AVX2 versions are picked at runtime by get_surface_kernels(), with a scalar fallback,
+        the 3 levels give the same bits. this is the formula, not whatever SDL_BlitSurface() picks:
+        SDL builds with MMX (all the x86-64 ones) blit ARGB8888 with BlitRGBtoRGBPixelAlphaMMX instead.
+        surface_tests.cpp checks every level against the formula, and prints the SDL_BlitSurface() result for information.
+    */
+    struct SurfaceKernels {
+        void (*fill)(uint32_t* dst, int n, uint32_t color);
+        void (*blend)(const uint32_t* src, uint32_t* dst, int n);
+        void (*blend_premultiplied)(const uint32_t* src, uint32_t* dst, int n);
+        void (*copy_colorkey)(const uint32_t* src, uint32_t* dst, int n, uint32_t key);
+        void (*swap_rb)(const uint32_t* src, uint32_t* dst, int n);
+        const char* name;
+    };
+
+    namespace kernels {
+        inline uint32_t div255(uint32_t x) noexcept {
+            x += 1;
+            return (x + (x >> 8)) >> 8;
+        }
+
+        inline uint32_t blend_pixel(uint32_t s, uint32_t d) noexcept {
+            uint32_t sa = s >> 24;
+            if (sa == 0) {
+                return d;
+            }
+
+            if (sa == 255) {
+                return s;
+            }
+
+            // the 2 outer channels at once, the same modulo 2^32 arithmetic as SDL.
+            uint32_t rb = d & 0xff00ff;
+            rb = (rb + (((s & 0xff00ff) - rb) * sa >> 8)) & 0xff00ff;
+            uint32_t g = d & 0xff00;
+            g = (g + (((s & 0xff00) - g) * sa >> 8)) & 0xff00;
+            uint32_t da = sa + ((d >> 24) * (255 - sa) >> 8);
+            return rb | g | (da << 24);
+        }
+
+        inline uint32_t blend_premultiplied_pixel(uint32_t s, uint32_t d) noexcept {
+            uint32_t inv = 255 - (s >> 24);
+            uint32_t result = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t c = ((s >> shift) & 0xff) + div255(((d >> shift) & 0xff) * inv);
+                result |= std::min<uint32_t>(c, 255) << shift;
+            }
+
+            return result;
+        }
+
+        inline uint32_t swap_rb_pixel(uint32_t p) noexcept {
+            return (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+        }
+
+        inline void fill_scalar(uint32_t* dst, int n, uint32_t color) {
+            for (int i = 0; i < n; ++i) {
+                dst[i] = color;
+            }
+        }
+
+        inline void blend_scalar(const uint32_t* src, uint32_t* dst, int n) {
+            for (int i = 0; i < n; ++i) {
+                dst[i] = blend_pixel(src[i], dst[i]);
+            }
+        }
+
+        inline void blend_premultiplied_scalar(const uint32_t* src, uint32_t* dst, int n) {
+            for (int i = 0; i < n; ++i) {
+                dst[i] = blend_premultiplied_pixel(src[i], dst[i]);
+            }
+        }
+
+        inline void copy_colorkey_scalar(const uint32_t* src, uint32_t* dst, int n, uint32_t key) {
+            key &= 0x00ffffff;
+            for (int i = 0; i < n; ++i) {
+                if ((src[i] & 0x00ffffff) != key) {
+                    dst[i] = src[i];
+                }
+            }
+        }
+
+        inline void swap_rb_scalar(const uint32_t* src, uint32_t* dst, int n) {
+            for (int i = 0; i < n; ++i) {
+                dst[i] = swap_rb_pixel(src[i]);
+            }
+        }
+
+#ifdef SDL2_WRAPPER_SSE2
+        /*
+            blends 2 pixels unpacked to 16 bits lanes, without the sA == 0 / 255 cases.
+            (s - d) * a overflows 16 bits, but its bits 8-15 are right modulo 2^16, and only the low 8 bits of d + them are kept.
+        */
+        inline __m128i blend_16_sse2(__m128i s, __m128i d) {
+            const __m128i colorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+            const __m128i low8 = _mm_set1_epi16(0xff);
+
+            __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i c = _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(s, d), a), 8);
+            c = _mm_and_si128(_mm_add_epi16(d, c), low8);
+            __m128i alpha = _mm_add_epi16(a, _mm_srli_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(low8, a)), 8));
+            return _mm_or_si128(_mm_and_si128(colorLanes, c), _mm_andnot_si128(colorLanes, alpha));
+        }
+
+        // dst where sA == 0, src where sA == 255, else the blended pixels.
+        inline __m128i select_alpha_sse2(__m128i s, __m128i d, __m128i blended) {
+            const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+
+            __m128i sa = _mm_and_si128(s, alphaMask);
+            __m128i opaque = _mm_cmpeq_epi32(sa, alphaMask);
+            __m128i clear = _mm_cmpeq_epi32(sa, _mm_setzero_si128());
+            blended = _mm_or_si128(_mm_and_si128(opaque, s), _mm_andnot_si128(opaque, blended));
+            return _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, blended));
+        }
+
+        inline __m128i blend_premultiplied_16_sse2(__m128i s, __m128i d) {
+            const __m128i v255 = _mm_set1_epi16(255);
+            const __m128i one = _mm_set1_epi16(1);
+
+            __m128i inv = _mm_sub_epi16(v255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+            __m128i x = _mm_add_epi16(_mm_mullo_epi16(d, inv), one);
+            x = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+            return _mm_add_epi16(s, x);
+        }
+
+        inline void fill_sse2(uint32_t* dst, int n, uint32_t color) {
+            __m128i c = _mm_set1_epi32(static_cast<int>(color));
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), c);
+            }
+
+            fill_scalar(dst + i, n - i, color);
+        }
+
+        inline void blend_sse2(const uint32_t* src, uint32_t* dst, int n) {
+            const __m128i zero = _mm_setzero_si128();
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+                __m128i lo = blend_16_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+                __m128i hi = blend_16_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), select_alpha_sse2(s, d, _mm_packus_epi16(lo, hi)));
+            }
+
+            blend_scalar(src + i, dst + i, n - i);
+        }
+
+        inline void blend_premultiplied_sse2(const uint32_t* src, uint32_t* dst, int n) {
+            const __m128i zero = _mm_setzero_si128();
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+                __m128i lo = blend_premultiplied_16_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+                __m128i hi = blend_premultiplied_16_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+            }
+
+            blend_premultiplied_scalar(src + i, dst + i, n - i);
+        }
+
+        inline void copy_colorkey_sse2(const uint32_t* src, uint32_t* dst, int n, uint32_t key) {
+            const __m128i rgbMask = _mm_set1_epi32(0x00ffffff);
+            __m128i k = _mm_set1_epi32(static_cast<int>(key & 0x00ffffff));
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+                __m128i keep = _mm_cmpeq_epi32(_mm_and_si128(s, rgbMask), k);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s)));
+            }
+
+            copy_colorkey_scalar(src + i, dst + i, n - i, key);
+        }
+
+        inline void swap_rb_sse2(const uint32_t* src, uint32_t* dst, int n) {
+            const __m128i agMask = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+            const __m128i byteMask = _mm_set1_epi32(0xff);
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i r = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), byteMask), _mm_slli_epi32(_mm_and_si128(p, byteMask), 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_and_si128(p, agMask), r));
+            }
+
+            swap_rb_scalar(src + i, dst + i, n - i);
         }
-    }
 
-    void sdl_set_render_draw_blend_mode(Renderer& renderer, SDL_BlendMode blendMode) {
-        if (SDL_SetRenderDrawBlendMode(renderer.get(), blendMode) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_SetRenderDrawBlendMode() failed", sdlErrMsg };
+        SDL2_WRAPPER_TARGET_AVX2 inline __m256i blend_16_avx2(__m256i s, __m256i d) {
+            const __m256i colorLanes = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+            const __m256i low8 = _mm256_set1_epi16(0xff);
+
+            __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m256i c = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(s, d), a), 8);
+            c = _mm256_and_si256(_mm256_add_epi16(d, c), low8);
+            __m256i alpha = _mm256_add_epi16(a, _mm256_srli_epi16(_mm256_mullo_epi16(d, _mm256_sub_epi16(low8, a)), 8));
+            return _mm256_blendv_epi8(alpha, c, colorLanes);
         }
-    }
 
-    void sdl_render_fill_rect(Renderer& renderer, const SDL_Rect* rect) {
-        if (SDL_RenderFillRect(renderer.get(), rect) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderFillRect() failed", sdlErrMsg };
+        SDL2_WRAPPER_TARGET_AVX2 inline __m256i blend_premultiplied_16_avx2(__m256i s, __m256i d) {
+            const __m256i v255 = _mm256_set1_epi16(255);
+            const __m256i one = _mm256_set1_epi16(1);
+
+            __m256i inv = _mm256_sub_epi16(v255, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+            __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(d, inv), one);
+            x = _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+            return _mm256_add_epi16(s, x);
         }
-    }
 
-    void sdl_render_draw_rect(Renderer& renderer, const SDL_Rect* rect) {
-        if (SDL_RenderDrawRect(renderer.get(), rect) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderDrawRect() failed", sdlErrMsg };
+        SDL2_WRAPPER_TARGET_AVX2 inline void fill_avx2(uint32_t* dst, int n, uint32_t color) {
+            __m256i c = _mm256_set1_epi32(static_cast<int>(color));
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), c);
+            }
+
+            fill_sse2(dst + i, n - i, color);
         }
-    }
 
-    void sdl_render_draw_line(Renderer& renderer, int x1, int y1, int x2, int y2) {
-        if (SDL_RenderDrawLine(renderer.get(), x1, y1, x2, y2) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderDrawLine() failed", sdlErrMsg };
+        SDL2_WRAPPER_TARGET_AVX2 inline void blend_avx2(const uint32_t* src, uint32_t* dst, int n) {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xff000000));
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+                __m256i lo = blend_16_avx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+                __m256i hi = blend_16_avx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+
+                // dst where sA == 0, src where sA == 255.
+                __m256i sa = _mm256_and_si256(s, alphaMask);
+                __m256i p = _mm256_blendv_epi8(_mm256_packus_epi16(lo, hi), s, _mm256_cmpeq_epi32(sa, alphaMask));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_blendv_epi8(p, d, _mm256_cmpeq_epi32(sa, zero)));
+            }
+
+            blend_sse2(src + i, dst + i, n - i);
         }
-    }
 
-    void sdl_render_draw_lines(Renderer& renderer, const SDL_Point* points, int pointNum) {
-        if (SDL_RenderDrawLines(renderer.get(), points, pointNum) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderDrawLines() failed", sdlErrMsg };
+        SDL2_WRAPPER_TARGET_AVX2 inline void blend_premultiplied_avx2(const uint32_t* src, uint32_t* dst, int n) {
+            const __m256i zero = _mm256_setzero_si256();
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+                __m256i lo = blend_premultiplied_16_avx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+                __m256i hi = blend_premultiplied_16_avx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+            }
+
+            blend_premultiplied_sse2(src + i, dst + i, n - i);
         }
-    }
 
-    void sdl_render_copy(Renderer& renderer, Texture& texture, const SDL_Rect* srcRect, const SDL_Rect* dstRect) {
-        if (SDL_RenderCopy(renderer.get(), texture.get(), srcRect, dstRect) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderCopy() failed", sdlErrMsg };
+        SDL2_WRAPPER_TARGET_AVX2 inline void copy_colorkey_avx2(const uint32_t* src, uint32_t* dst, int n, uint32_t key) {
+            const __m256i rgbMask = _mm256_set1_epi32(0x00ffffff);
+            __m256i k = _mm256_set1_epi32(static_cast<int>(key & 0x00ffffff));
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+                __m256i keep = _mm256_cmpeq_epi32(_mm256_and_si256(s, rgbMask), k);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_blendv_epi8(s, d, keep));
+            }
+
+            copy_colorkey_sse2(src + i, dst + i, n - i, key);
         }
-    }
 
-    void sdl_render_copy_ex(Renderer& renderer, 
-                            Texture& texture, 
-                            const SDL_Rect* srcRect, 
-                            const SDL_Rect* dstRect, 
-                            const double angle,
-                            const SDL_Point* center,
-                            const SDL_RendererFlip flip) {
-        if (SDL_RenderCopyEx(renderer.get(), texture.get(), srcRect, dstRect, angle, center, flip) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderCopyEx() failed", sdlErrMsg };
+        SDL2_WRAPPER_TARGET_AVX2 inline void swap_rb_avx2(const uint32_t* src, uint32_t* dst, int n) {
+            const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                                     2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(p, shuffle));
+            }
+
+            swap_rb_sse2(src + i, dst + i, n - i);
         }
-    }
+#endif
 
-    void sdl_render_set_scale(Renderer& renderer, float scaleX, float scaleY) {
-        if (SDL_RenderSetScale(renderer.get(), scaleX, scaleY) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderSetScale() failed", sdlErrMsg };
+        // one row of rect inside a surface.
+        inline uint32_t* row32(SDL_Surface* surface, int x, int y) noexcept {
+            return reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch) + x;
         }
-    }
 
-    void sdl_render_set_viewport(Renderer& renderer, const SDL_Rect* rect) {
-        if (SDL_RenderSetViewport(renderer.get(), rect) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RenderSetViewport() failed", sdlErrMsg };
+        inline uint8_t* row8(SDL_Surface* surface, int x, int y) noexcept {
+            return static_cast<uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch + x * surface->format->BytesPerPixel;
         }
-    }
 
-    void sdl_render_present(Renderer& renderer) noexcept {
-        SDL_RenderPresent(renderer.get());
-    }
+        // locks the surface for the lifetime of the guard, if it needs it.
+        class SurfaceLock {
+            SDL_Surface* surface;
+        public:
+            SurfaceLock(SDL_Surface* _surface) : surface{ SDL_MUSTLOCK(_surface) ? _surface : nullptr } {
+                if (surface && SDL_LockSurface(surface) < 0) {
+                    const char* sdlErrMsg = SDL_GetError();
+                    throw SDL2Exception{ "SDL_LockSurface() failed", sdlErrMsg };
+                }
+            }
 
-    Texture sdl_create_texture_from_surface(Renderer& renderer, SDL_Surface* surface) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer.get(), surface);
-        if (texture == nullptr) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_CreateTextureFromSurface() failed", sdlErrMsg };
+            SurfaceLock(const SurfaceLock&) = delete;
+            SurfaceLock& operator=(const SurfaceLock&) = delete;
+
+            ~SurfaceLock() {
+                if (surface) {
+                    SDL_UnlockSurface(surface);
+                }
+            }
+        };
+
+        inline void require_32bits(SDL_Surface* surface, const char* userMsg) {
+            if (surface->format->BytesPerPixel != 4) {
+                throw SDL2Exception{ userMsg, "the surface must have 32 bits pixels" };
+            }
         }
 
-        return Texture{ texture };
-    }
+        // clips a blit of src (srcRect) to dst at (x, y), like SDL_BlitSurface(). returns false if nothing is left.
+        inline bool clip_blit(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, int x, int y, SDL_Rect& s, SDL_Rect& d) {
+            SDL_Rect whole = { 0, 0, src->w, src->h };
+            if (!SDL_IntersectRect(srcRect ? srcRect : &whole, &whole, &s)) {
+                return false;
+            }
 
-    void sdl_query_texture(Texture& texture, uint32_t* format, int* access, int* w, int* h) {
-        if (SDL_QueryTexture(texture.get(), format, access, w, h) < 0) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_QueryTexture() failed", sdlErrMsg };
+            if (srcRect) {
+                x += s.x - srcRect->x;
+                y += s.y - srcRect->y;
+            }
+
+            SDL_Rect target = { x, y, s.w, s.h };
+            if (!SDL_IntersectRect(&target, &dst->clip_rect, &d)) {
+                return false;
+            }
+
+            s.x += d.x - x;
+            s.y += d.y - y;
+            s.w = d.w;
+            s.h = d.h;
+            return true;
         }
     }
-}
 
-/******************************* sdl2 ttf part. **********************************/
-namespace sdl2 {
-    class SDL2TTF {
-    public:
-        SDL2TTF() {
-            if (TTF_Init() < 0) {
-                const char* ttfErrMsg = TTF_GetError();
-                throw SDL2Exception{ "TTF_Init() failed", ttfErrMsg };
+    namespace kernels {
+        // the kernels of a level, "scalar", "sse2" or "avx2", nullptr if the build or the cpu doesn't have it.
+        inline const SurfaceKernels* find_surface_kernels(const char* name) {
+            static const SurfaceKernels scalar{ fill_scalar, blend_scalar, blend_premultiplied_scalar, copy_colorkey_scalar, swap_rb_scalar, "scalar" };
+            if (strcmp(name, scalar.name) == 0) {
+                return &scalar;
             }
-        }
 
-        SDL2TTF(const SDL2TTF&) = delete;
-        SDL2TTF& operator=(const SDL2TTF&) = delete;
-        SDL2TTF(SDL2TTF&&) = delete;
-        SDL2TTF& operator=(SDL2TTF&&) = delete;
+#ifdef SDL2_WRAPPER_SSE2
+            static const SurfaceKernels sse2{ fill_sse2, blend_sse2, blend_premultiplied_sse2, copy_colorkey_sse2, swap_rb_sse2, "sse2" };
+            if (strcmp(name, sse2.name) == 0 && SDL_HasSSE2()) {
+                return &sse2;
+            }
 
-        ~SDL2TTF() {
-            TTF_Quit();
+            static const SurfaceKernels avx2{ fill_avx2, blend_avx2, blend_premultiplied_avx2, copy_colorkey_avx2, swap_rb_avx2, "avx2" };
+            if (strcmp(name, avx2.name) == 0 && SDL_HasAVX2()) {
+                return &avx2;
+            }
+#endif
+            return nullptr;
         }
-    };
 
-    class Font {
-        TTF_Font* font;
-    public:
-        Font(const std::string& fontFilePath, int pointSize) {
-            if ((font = TTF_OpenFont(fontFilePath.c_str(), pointSize)) == nullptr) {
-                const char* ttfErrMsg = TTF_GetError();
-                throw SDL2Exception{ "TTF_OpenFont() failed", ttfErrMsg };
-            }
+        inline const SurfaceKernels*& selected_surface_kernels() {
+            static const SurfaceKernels* selected = [] {
+                const SurfaceKernels* best = find_surface_kernels("avx2");
+                if (best == nullptr) {
+                    best = find_surface_kernels("sse2");
+                }
+
+                return best ? best : find_surface_kernels("scalar");
+            }();
+
+            return selected;
         }
+    }
 
-        Font(const Font&) = delete;
-        Font& operator=(const Font&) = delete;
+    inline const SurfaceKernels& get_surface_kernels() {
+        return *kernels::selected_surface_kernels();
+    }
 
-        Font(Font && other) noexcept 
-            : font { other.font }  
-        {
-            other.font = nullptr;
+    /*
+        forces the level of the surface kernels, "scalar", "sse2" or "avx2", for the tests and the benchmarks.
+        returns false and keeps the current level if the build or the cpu doesn't have it.
+        not thread safe, call it while nothing blits.
+    */
+    inline bool set_surface_kernels(const char* name) {
+        const SurfaceKernels* found = kernels::find_surface_kernels(name);
+        if (found == nullptr) {
+            return false;
         }
 
-        Font& operator=(Font&& other) noexcept {
-            if (this != &other) {
-                font = other.font;
-                other.font = nullptr;
-            }
+        kernels::selected_surface_kernels() = found;
+        return true;
+    }
 
-            return *this;
+    // like SDL_FillRect(), color is a pixel value of the surface format. other than 32 bits surfaces go to SDL_FillRect().
+    void surface_fill(SDL_Surface* dst, const SDL_Rect* rect, uint32_t color) {
+        if (dst->format->BytesPerPixel != 4) {
+            sdl_fill_rect(dst, rect, color);
+            return;
         }
 
-        ~Font() {
-            if (font) {
-                TTF_CloseFont(font);
-            }
+        SDL_Rect r;
+        if (!SDL_IntersectRect(rect ? rect : &dst->clip_rect, &dst->clip_rect, &r)) {
+            return;
         }
 
-        TTF_Font* get() {
-            return font;
+        kernels::SurfaceLock lock{ dst };
+        const SurfaceKernels& k = get_surface_kernels();
+        for (int y = r.y; y < r.y + r.h; ++y) {
+            k.fill(kernels::row32(dst, r.x, y), r.w, color);
         }
-    };
+    }
 
-    Surface ttf_render_utf8_blended(Font& font, const std::string& text, SDL_Color fg) {
-        SDL_Surface* surf = TTF_RenderUTF8_Blended(font.get(), text.c_str(), fg);
+    /*
+        straight alpha blend of src on dst at (x, y), the formula of SDL's C blitter for SDL_BLENDMODE_BLEND (see above).
+        both must be in the same 32 bits format with the alpha in the top byte (ARGB8888, ABGR8888),
+        or dst without alpha (XRGB8888, XBGR8888), then its top byte is undefined.
+    */
+    void surface_blend(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, int x, int y) {
+        kernels::require_32bits(src, "surface_blend() failed");
+        kernels::require_32bits(dst, "surface_blend() failed");
 
-        if (surf == nullptr) {
-            const char* ttfErrMsg = TTF_GetError();
-            throw SDL2Exception{ "TTF_RenderUTF8_Blended() failed", ttfErrMsg };
+        SDL_Rect s, d;
+        if (!kernels::clip_blit(src, srcRect, dst, x, y, s, d)) {
+            return;
         }
 
-        return Surface{ surf };
+        kernels::SurfaceLock srcLock{ src };
+        kernels::SurfaceLock dstLock{ dst };
+        const SurfaceKernels& k = get_surface_kernels();
+        for (int row = 0; row < d.h; ++row) {
+            k.blend(kernels::row32(src, s.x, s.y + row), kernels::row32(dst, d.x, d.y + row), d.w);
+        }
     }
 
-    Surface ttf_render_text_solid(Font& font, const std::string& text, SDL_Color fg) {
-        SDL_Surface* surf = TTF_RenderText_Solid(font.get(), text.c_str(), fg);
-        if (surf == nullptr) {
-            const char* ttfErrMsg = TTF_GetError();
-            throw SDL2Exception{ "TTF_RenderText_Solid() failed", ttfErrMsg };
+    // premultiplied alpha blend: dst = src + dst * (1 - srcA), on every channel.
+    void surface_blend_premultiplied(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, int x, int y) {
+        kernels::require_32bits(src, "surface_blend_premultiplied() failed");
+        kernels::require_32bits(dst, "surface_blend_premultiplied() failed");
+
+        SDL_Rect s, d;
+        if (!kernels::clip_blit(src, srcRect, dst, x, y, s, d)) {
+            return;
         }
 
-        return Surface{ surf };
+        kernels::SurfaceLock srcLock{ src };
+        kernels::SurfaceLock dstLock{ dst };
+        const SurfaceKernels& k = get_surface_kernels();
+        for (int row = 0; row < d.h; ++row) {
+            k.blend_premultiplied(kernels::row32(src, s.x, s.y + row), kernels::row32(dst, d.x, d.y + row), d.w);
+        }
     }
-}
 
-/******************************* sdl2 image part. **********************************/
-namespace sdl2 {
-    Surface img_load(const std::string& filePath) {
-        SDL_Surface* surf = IMG_Load(filePath.c_str());
-        if (surf == nullptr) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "IMG_Load() failed", sdlErrMsg };
+    // copies the pixels whose rgb differs from the key's, like SDL_BlitSurface() with a color key between 2 surfaces of the same 32 bits format.
+    void surface_copy_colorkey(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, int x, int y, uint32_t key) {
+        kernels::require_32bits(src, "surface_copy_colorkey() failed");
+        kernels::require_32bits(dst, "surface_copy_colorkey() failed");
+
+        SDL_Rect s, d;
+        if (!kernels::clip_blit(src, srcRect, dst, x, y, s, d)) {
+            return;
         }
 
-        return Surface{ surf };
+        kernels::SurfaceLock srcLock{ src };
+        kernels::SurfaceLock dstLock{ dst };
+        const SurfaceKernels& k = get_surface_kernels();
+        for (int row = 0; row < d.h; ++row) {
+            k.copy_colorkey(kernels::row32(src, s.x, s.y + row), kernels::row32(dst, d.x, d.y + row), d.w, key);
+        }
     }
-}
 
-/******************************* sdl2 mixer part. **********************************/
-namespace sdl2 {
-    class SDL2Mixer {
-    public:
-        SDL2Mixer() {}
+    /*
+        converts the pixels of src into dst, both must have the same size. supported:
+        the same format (a copy), ARGB8888 <-> ABGR8888, XRGB8888 <-> XBGR8888, RGB24 <-> BGR24,
+        RGB24 / BGR24 -> ARGB8888 / XRGB8888 / ABGR8888 / XBGR8888 and back.
+        like SDL, a source without alpha gives opaque pixels. use SDL_ConvertSurfaceFormat() for anything else.
+        the 32 bits formats are packed, they are handled as uint32_t values, the 24 bits ones are byte arrays,
+        they are read and written byte by byte, so the mapping doesn't depend on SDL_BYTEORDER.
+    */
+    void surface_convert(SDL_Surface* src, SDL_Surface* dst) {
+        if (src->w != dst->w || src->h != dst->h) {
+            throw SDL2Exception{ "surface_convert() failed", "the surfaces must have the same size" };
+        }
 
-        SDL2Mixer(const SDL2Mixer&) = delete;
-        SDL2Mixer& operator=(const SDL2Mixer&) = delete;
-        SDL2Mixer(SDL2Mixer&&) = delete;
-        SDL2Mixer& operator=(SDL2Mixer&&) = delete;
+        uint32_t from = src->format->format;
+        uint32_t to = dst->format->format;
+        bool from32 = from == SDL_PIXELFORMAT_ARGB8888 || from == SDL_PIXELFORMAT_XRGB8888 || from == SDL_PIXELFORMAT_ABGR8888 || from == SDL_PIXELFORMAT_XBGR8888;
+        bool to32 = to == SDL_PIXELFORMAT_ARGB8888 || to == SDL_PIXELFORMAT_XRGB8888 || to == SDL_PIXELFORMAT_ABGR8888 || to == SDL_PIXELFORMAT_XBGR8888;
+        bool from24 = from == SDL_PIXELFORMAT_RGB24 || from == SDL_PIXELFORMAT_BGR24;
+        bool to24 = to == SDL_PIXELFORMAT_RGB24 || to == SDL_PIXELFORMAT_BGR24;
 
-        ~SDL2Mixer() {
-            Mix_Quit();
-        }
+        // the red channel of ARGB8888 / XRGB8888 values is bits 16-23, and the third byte (index 2) of BGR24 pixels,
+        // so BGR24 byte i goes to bits 8 * i, the order of ARGB8888.
+        bool fromRgbOrder = from == SDL_PIXELFORMAT_ARGB8888 || from == SDL_PIXELFORMAT_XRGB8888 || from == SDL_PIXELFORMAT_BGR24;
+        bool toRgbOrder = to == SDL_PIXELFORMAT_ARGB8888 || to == SDL_PIXELFORMAT_XRGB8888 || to == SDL_PIXELFORMAT_BGR24;
+        bool swap = fromRgbOrder != toRgbOrder;
+        uint32_t opaque = !SDL_ISPIXELFORMAT_ALPHA(from) && SDL_ISPIXELFORMAT_ALPHA(to) ? 0xff000000 : 0;
 
-        // this call is optional.
-        int do_mixer_init(int flags) noexcept {
-            return Mix_Init(flags);
+        if (!((from == to) || (from32 && to32) || (from24 && to24) || (from24 && to32) || (from32 && to24))) {
+            throw SDL2Exception{ "surface_convert() failed", "unsupported pixel formats" };
         }
-    };
 
-    class MixOpenAudio {
-    public:
-        MixOpenAudio(int frequency, uint16_t format, int channels, int chunksize) {
-            if (Mix_OpenAudio(frequency, format, channels, chunksize) < 0) {
-                const char* mixErrMsg = Mix_GetError();
-                throw SDL2Exception{ "Mix_OpenAudio() failed", mixErrMsg };
+        kernels::SurfaceLock srcLock{ src };
+        kernels::SurfaceLock dstLock{ dst };
+        const SurfaceKernels& k = get_surface_kernels();
+        int w = src->w;
+        size_t rowBytes = static_cast<size_t>(w) * src->format->BytesPerPixel;
+
+        for (int y = 0; y < src->h; ++y) {
+            if (from == to) {
+                memcpy(kernels::row8(dst, 0, y), kernels::row8(src, 0, y), rowBytes);
+            }
+            else if (from32 && to32) {
+                if (swap) {
+                    k.swap_rb(kernels::row32(src, 0, y), kernels::row32(dst, 0, y), w);
+                }
+                else {
+                    memcpy(kernels::row8(dst, 0, y), kernels::row8(src, 0, y), rowBytes);
+                }
+
+                if (opaque) {
+                    uint32_t* d = kernels::row32(dst, 0, y);
+                    for (int x = 0; x < w; ++x) {
+                        d[x] |= opaque;
+                    }
+                }
+            }
+            else if (from24 && to24) {
+                // RGB24 <-> BGR24, the 1st and 3rd bytes swap.
+                const uint8_t* s = kernels::row8(src, 0, y);
+                uint8_t* d = kernels::row8(dst, 0, y);
+                for (int x = 0; x < w; ++x, s += 3, d += 3) {
+                    d[0] = s[2];
+                    d[1] = s[1];
+                    d[2] = s[0];
+                }
+            }
+            else if (from24) {
+                // the bytes c0 c1 c2 give the value (c0) | (c1 << 8) | (c2 << 16), which is BGR24 -> ARGB8888.
+                const uint8_t* s = kernels::row8(src, 0, y);
+                uint32_t* d = kernels::row32(dst, 0, y);
+                for (int x = 0; x < w; ++x, s += 3) {
+                    uint32_t p = 0xff000000 | s[0] | (s[1] << 8) | (static_cast<uint32_t>(s[2]) << 16);
+                    d[x] = swap ? kernels::swap_rb_pixel(p) : p;
+                }
+            }
+            else {
+                const uint32_t* s = kernels::row32(src, 0, y);
+                uint8_t* d = kernels::row8(dst, 0, y);
+                for (int x = 0; x < w; ++x, d += 3) {
+                    uint32_t p = swap ? kernels::swap_rb_pixel(s[x]) : s[x];
+                    d[0] = static_cast<uint8_t>(p);
+                    d[1] = static_cast<uint8_t>(p >> 8);
+                    d[2] = static_cast<uint8_t>(p >> 16);
+                }
             }
         }
+    }
 
-        MixOpenAudio(const MixOpenAudio&) = delete;
-        MixOpenAudio& operator=(const MixOpenAudio&) = delete;
-        MixOpenAudio(MixOpenAudio&&) = delete;
-        MixOpenAudio& operator=(MixOpenAudio&&) = delete;
+    /*
+        a software compositor for the window surface path. the blits and fills of a frame are recorded,
+        binned into square tiles of the target, then the tiles are rasterized in parallel,
+        each tile runs its ops in the recorded order, so the result is the same as running them one by one.
 
-        ~MixOpenAudio() {
-            Mix_CloseAudio();
+            sdl2::Compositor compositor{ 128 };
+            compositor.begin(window);
+            compositor.fill(nullptr, background);
+            compositor.blend(sprite.get(), nullptr, x, y);
+            compositor.present();
+
+        all the surfaces must have 32 bits pixels, the sources must stay alive until composite() or present() returns.
+    */
+    class Compositor {
+        enum class OpKind : uint8_t {
+            FILL, BLEND, BLEND_PREMULTIPLIED, COPY, COPY_COLORKEY
+        };
+
+        struct Op {
+            OpKind kind;
+            SDL_Surface* src;
+            int srcX;
+            int srcY;
+            SDL_Rect dstRect;
+            uint32_t value;
+        };
+
+        std::unique_ptr<ThreadPool> pool;
+        int tileSize;
+        SDL_Surface* target;
+        Window* window;
+        std::vector<Op> ops;
+        std::vector<std::vector<uint32_t>> bins;
+        int tilesX;
+        int tilesY;
+
+        void push(OpKind kind, SDL_Surface* src, const SDL_Rect* srcRect, int x, int y, uint32_t value, const char* userMsg) {
+            if (target == nullptr) {
+                throw SDL2Exception{ userMsg, "begin() was not called" };
+            }
+
+            kernels::require_32bits(src, userMsg);
+
+            SDL_Rect s, d;
+            if (kernels::clip_blit(src, srcRect, target, x, y, s, d)) {
+                ops.push_back(Op{ kind, src, s.x, s.y, d, value });
+            }
         }
-    };
 
-    class MixChunk {
-        Mix_Chunk* chunk;
+        void render_tile(int tile) {
+            const SurfaceKernels& k = get_surface_kernels();
+            SDL_Rect tileRect = { (tile % tilesX) * tileSize, (tile / tilesX) * tileSize, tileSize, tileSize };
+
+            for (uint32_t index : bins[tile]) {
+                const Op& op = ops[index];
+                SDL_Rect r;
+                if (!SDL_IntersectRect(&op.dstRect, &tileRect, &r)) {
+                    continue;
+                }
+
+                int srcX = op.srcX + r.x - op.dstRect.x;
+                int srcY = op.srcY + r.y - op.dstRect.y;
+                for (int row = 0; row < r.h; ++row) {
+                    uint32_t* dst = kernels::row32(target, r.x, r.y + row);
+                    const uint32_t* src = op.src ? kernels::row32(op.src, srcX, srcY + row) : nullptr;
+
+                    switch (op.kind) {
+                    case OpKind::FILL:
+                        k.fill(dst, r.w, op.value);
+                        break;
+                    case OpKind::BLEND:
+                        k.blend(src, dst, r.w);
+                        break;
+                    case OpKind::BLEND_PREMULTIPLIED:
+                        k.blend_premultiplied(src, dst, r.w);
+                        break;
+                    case OpKind::COPY:
+                        memcpy(dst, src, r.w * sizeof(uint32_t));
+                        break;
+                    case OpKind::COPY_COLORKEY:
+                        k.copy_colorkey(src, dst, r.w, op.value);
+                        break;
+                    }
+                }
+            }
+        }
     public:
-        MixChunk() : chunk { nullptr } {}
-        MixChunk(Mix_Chunk* _chunk) : chunk{ _chunk } {}
+        // threadNum counts the calling thread, 0 means one per cpu core.
+        Compositor(int _tileSize = 128, unsigned threadNum = 0) : pool{}, tileSize{ _tileSize }, target{ nullptr }, window{ nullptr }, ops{}, bins{}, tilesX{ 0 }, tilesY{ 0 } {
+            if (threadNum == 0) {
+                threadNum = static_cast<unsigned>(std::max(1, SDL_GetCPUCount()));
+            }
 
-        MixChunk(const MixChunk&) = delete;
-        MixChunk& operator=(const MixChunk&) = delete;
+            if (threadNum > 1) {
+                pool.reset(new ThreadPool{ threadNum - 1 });
+            }
+        }
 
-        MixChunk(MixChunk && other) noexcept 
-            : chunk { other.chunk }  
-        {
-            other.chunk = nullptr;
+        Compositor(const Compositor&) = delete;
+        Compositor& operator=(const Compositor&) = delete;
+
+        ~Compositor() {}
+
+        // starts a frame on the window surface, present() composites it and updates the window.
+        void begin(Window& _window) {
+            begin(sdl_window_get_surface(_window));
+            window = &_window;
         }
 
-        MixChunk& operator=(MixChunk&& other) noexcept {
-            if (this != &other) {
-                chunk = other.chunk;
-                other.chunk = nullptr;
+        void begin(SDL_Surface* _target) {
+            if (_target == nullptr) {
+                throw SDL2Exception{ "Compositor::begin() failed", "the target is null" };
             }
 
-            return *this;
+            kernels::require_32bits(_target, "Compositor::begin() failed");
+            target = _target;
+            window = nullptr;
+            ops.clear();
+            tilesX = (target->w + tileSize - 1) / tileSize;
+            tilesY = (target->h + tileSize - 1) / tileSize;
         }
 
-        ~MixChunk() {
-            if (chunk) {
-                Mix_FreeChunk(chunk);
+        // color is a pixel value of the target format, a null rect fills the whole target.
+        void fill(const SDL_Rect* rect, uint32_t color) {
+            if (target == nullptr) {
+                throw SDL2Exception{ "Compositor::fill() failed", "begin() was not called" };
+            }
+
+            SDL_Rect r;
+            if (SDL_IntersectRect(rect ? rect : &target->clip_rect, &target->clip_rect, &r)) {
+                ops.push_back(Op{ OpKind::FILL, nullptr, 0, 0, r, color });
             }
         }
 
-        Mix_Chunk* get() noexcept {
-            return chunk;
+        void blend(SDL_Surface* src, const SDL_Rect* srcRect, int x, int y) {
+            push(OpKind::BLEND, src, srcRect, x, y, 0, "Compositor::blend() failed");
         }
-    };
 
-    SDL_RWops* sdl_rw_from_file(const std::string& file, const std::string& mode) {
-        SDL_RWops* ops = SDL_RWFromFile(file.c_str(), mode.c_str());
-        if (ops == nullptr) {
-            const char* sdlErrMsg = SDL_GetError();
-            throw SDL2Exception{ "SDL_RWFromFile() failed", sdlErrMsg };
+        void blend_premultiplied(SDL_Surface* src, const SDL_Rect* srcRect, int x, int y) {
+            push(OpKind::BLEND_PREMULTIPLIED, src, srcRect, x, y, 0, "Compositor::blend_premultiplied() failed");
         }
 
-        return ops;
-    }
+        // src must have the target format.
+        void copy(SDL_Surface* src, const SDL_Rect* srcRect, int x, int y) {
+            push(OpKind::COPY, src, srcRect, x, y, 0, "Compositor::copy() failed");
+        }
 
-    MixChunk mix_load_wav_rw(SDL_RWops* src, int freeSrc) {
-        Mix_Chunk* chunk = Mix_LoadWAV_RW(src, freeSrc);
-        if (chunk == nullptr) {
-            const char* mixErrMsg = Mix_GetError();
-            throw SDL2Exception{ "Mix_LoadWAV_RW() failed", mixErrMsg };
+        void copy_colorkey(SDL_Surface* src, const SDL_Rect* srcRect, int x, int y, uint32_t key) {
+            push(OpKind::COPY_COLORKEY, src, srcRect, x, y, key, "Compositor::copy_colorkey() failed");
         }
 
-        return MixChunk{ chunk };
-    }
+        // rasterizes the recorded ops into the target and clears them.
+        void composite() {
+            SDL2_PROFILE_SCOPE("Compositor::composite");
+
+            if (target == nullptr) {
+                throw SDL2Exception{ "Compositor::composite() failed", "begin() was not called" };
+            }
+
+            int tileNum = tilesX * tilesY;
+            if (static_cast<int>(bins.size()) < tileNum) {
+                bins.resize(tileNum);
+            }
+
+            for (int i = 0; i < tileNum; ++i) {
+                bins[i].clear();
+            }
+
+            for (size_t i = 0; i < ops.size(); ++i) {
+                const SDL_Rect& r = ops[i].dstRect;
+                int tx1 = (r.x + r.w - 1) / tileSize;
+                int ty1 = (r.y + r.h - 1) / tileSize;
+                for (int ty = r.y / tileSize; ty <= ty1; ++ty) {
+                    for (int tx = r.x / tileSize; tx <= tx1; ++tx) {
+                        bins[ty * tilesX + tx].push_back(static_cast<uint32_t>(i));
+                    }
+                }
+            }
+
+            // SDL counts the locks, a surface used by several ops can be locked several times.
+            std::vector<SDL_Surface*> locked{ target };
+            std::exception_ptr error;
+            for (const Op& op : ops) {
+                if (op.src) {
+                    locked.push_back(op.src);
+                }
+            }
+
+            size_t lockedNum = 0;
+            for (; lockedNum < locked.size(); ++lockedNum) {
+                if (SDL_MUSTLOCK(locked[lockedNum]) && SDL_LockSurface(locked[lockedNum]) < 0) {
+                    break;
+                }
+            }
+
+            if (lockedNum == locked.size()) {
+                // the workers and the calling thread take the tiles one by one, so a busy tile doesn't stall the others.
+                std::atomic<int> nextTile{ 0 };
+                auto work = [this, &nextTile, tileNum] {
+                    for (int tile = nextTile++; tile < tileNum; tile = nextTile++) {
+                        render_tile(tile);
+                    }
+                };
+
+                std::vector<std::future<void>> results;
+                if (pool) {
+                    for (size_t i = 0; i < pool->size(); ++i) {
+                        results.push_back(pool->submit(work));
+                    }
+                }
+
+                work();
+                for (auto& result : results) {
+                    result.wait();
+                }
+            }
+            else {
+                const char* sdlErrMsg = SDL_GetError();
+                error = std::make_exception_ptr(SDL2Exception{ "SDL_LockSurface() failed", sdlErrMsg });
+            }
+
+            for (size_t i = 0; i < lockedNum; ++i) {
+                if (SDL_MUSTLOCK(locked[i])) {
+                    SDL_UnlockSurface(locked[i]);
+                }
+            }
 
-    void mix_play_channel(int channel, MixChunk& chunk, int loops) {
-        if (Mix_PlayChannel(channel, chunk.get(), loops) < 0) {
-            const char* mixErrMsg = Mix_GetError();
-            throw SDL2Exception{ "Mix_PlayChannel() failed", mixErrMsg };
+            ops.clear();
+            if (error) {
+                std::rethrow_exception(error);
+            }
         }
-    }
+
+        // composites and updates the window given to begin(), once.
+        void present() {
+            if (window == nullptr) {
+                throw SDL2Exception{ "Compositor::present() failed", "begin() was not called with a window" };
+            }
+
+            composite();
+            sdl_update_window_surface(*window);
+        }
+
+        size_t op_count() const noexcept {
+            return ops.size();
+        }
+
+        unsigned thread_count() const noexcept {
+            return pool ? static_cast<unsigned>(pool->size()) + 1 : 1;
+        }
+
+        int get_tile_size() const noexcept {
+            return tileSize;
+        }
+    };
 }
 
 #endif
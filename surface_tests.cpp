@@ -0,0 +1,304 @@
+/*
+    checks surface_fill(), surface_copy_colorkey() and surface_convert() against SDL_FillRect(),
+    SDL_BlitSurface() and SDL_ConvertSurfaceFormat(), byte for byte, with every kernel level
+    the cpu has (scalar, sse2, avx2). the sources cover the 256 alphas and the channel extremes.
+
+    surface_blend() is checked against blend_formula() below, the C formula of SDL's BlitRGBtoRGBPixelAlpha,
+    not against SDL_BlitSurface(): SDL builds with MMX (all the x86-64 ones) blit ARGB8888 with
+    BlitRGBtoRGBPixelAlphaMMX instead. the SDL_BlitSurface() result is printed too, as "informational",
+    it doesn't change the exit code.
+
+    one JSON object per line on stdout, the exit code is 1 if any counted check differs:
+
+        {"test":"blend/ARGB8888/0,0","kernels":"sse2","pixels":16832,"mismatches":0}
+
+    built by CMakeLists.txt, `ctest` runs it.
+*/
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include "sdl2_wrapper.hpp"
+
+#undef main
+
+// the column is the alpha, the rows pair the channel extremes, then pseudo random pixels.
+constexpr int WIDTH = 256 + 7;
+constexpr int PAIR_ROWS = 36;
+constexpr int HEIGHT = PAIR_ROWS + 28;
+
+const uint8_t EXTREMES[] = { 0, 1, 127, 128, 254, 255 };
+
+uint32_t random_pixel(int x, int y, uint32_t seed) {
+    uint32_t h = (static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(y) * 19349663u) ^ seed;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    return h ^ (h >> 15);
+}
+
+// the 32 bits value of the source pixel, alpha in the top byte.
+uint32_t src_pixel(int x, int y) {
+    uint32_t alpha = static_cast<uint32_t>(x & 0xff);
+    if (y >= PAIR_ROWS) {
+        return (alpha << 24) | (random_pixel(x, y, 1) & 0x00ffffff);
+    }
+
+    int i = y % 6;
+    int j = y / 6;
+    return (alpha << 24) | (EXTREMES[i] << 16) | (EXTREMES[j] << 8) | EXTREMES[(i + j) % 6];
+}
+
+// the destination pixel, every red / green pair of src and dst extremes meet on some row.
+uint32_t dst_pixel(int x, int y) {
+    if (y >= PAIR_ROWS) {
+        return random_pixel(x, y, 2);
+    }
+
+    int i = y % 6;
+    int j = y / 6;
+    uint32_t alpha = EXTREMES[(x + i) % 6];
+    return (alpha << 24) | (EXTREMES[j] << 16) | (EXTREMES[i] << 8) | EXTREMES[(i + 2 * j) % 6];
+}
+
+/*
+    a surface of format filled with pixel(x, y), the 32 bits value is written as is in 32 bits formats,
+    its low 3 bytes in memory order in 24 bits formats.
+*/
+sdl2::Surface make_surface(uint32_t format, uint32_t (*pixel)(int, int)) {
+    sdl2::Surface surface{ SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, SDL_BITSPERPIXEL(format), format) };
+    if (surface.get() == nullptr) {
+        const char* sdlErrMsg = SDL_GetError();
+        throw sdl2::SDL2Exception{ "SDL_CreateRGBSurfaceWithFormat() failed", sdlErrMsg };
+    }
+
+    for (int y = 0; y < HEIGHT; ++y) {
+        uint8_t* row = static_cast<uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch;
+        for (int x = 0; x < WIDTH; ++x) {
+            uint32_t p = pixel(x, y);
+            if (SDL_BYTESPERPIXEL(format) == 4) {
+                reinterpret_cast<uint32_t*>(row)[x] = p;
+            }
+            else {
+                row[x * 3] = static_cast<uint8_t>(p);
+                row[x * 3 + 1] = static_cast<uint8_t>(p >> 8);
+                row[x * 3 + 2] = static_cast<uint8_t>(p >> 16);
+            }
+        }
+    }
+
+    return surface;
+}
+
+/*
+    dst = the straight alpha blend of src at (x, y), one channel at a time:
+
+        sA == 0 keeps dst, sA == 255 copies src, else
+        dC = dC + floor((sC - dC) * sA / 256)
+        dA = sA + floor(dA * (255 - sA) / 256)
+*/
+uint32_t blend_formula(uint32_t s, uint32_t d) {
+    int sa = static_cast<int>(s >> 24);
+    if (sa == 0) {
+        return d;
+    }
+
+    if (sa == 255) {
+        return s;
+    }
+
+    uint32_t result = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int sc = static_cast<int>((s >> shift) & 0xff);
+        int dc = static_cast<int>((d >> shift) & 0xff);
+        // + 255 * 256 keeps the shifted value positive, so >> 8 is the floor.
+        int c = dc + (((sc - dc) * sa + 255 * 256) >> 8) - 255;
+        result |= static_cast<uint32_t>(c) << shift;
+    }
+
+    uint32_t da = static_cast<uint32_t>(sa) + ((d >> 24) * static_cast<uint32_t>(255 - sa) >> 8);
+    return result | (da << 24);
+}
+
+void blend_with_formula(SDL_Surface* src, SDL_Surface* dst, int x, int y) {
+    for (int sy = 0; sy < src->h; ++sy) {
+        int dy = sy + y;
+        if (dy < 0 || dy >= dst->h) {
+            continue;
+        }
+
+        const uint32_t* s = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(src->pixels) + static_cast<size_t>(sy) * src->pitch);
+        uint32_t* d = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(dst->pixels) + static_cast<size_t>(dy) * dst->pitch);
+        for (int sx = 0; sx < src->w; ++sx) {
+            int dx = sx + x;
+            if (dx >= 0 && dx < dst->w) {
+                d[dx] = blend_formula(s[sx], d[dx]);
+            }
+        }
+    }
+}
+
+sdl2::Surface convert_with_sdl(SDL_Surface* src, uint32_t format) {
+    sdl2::Surface surface{ SDL_ConvertSurfaceFormat(src, format, 0) };
+    if (surface.get() == nullptr) {
+        const char* sdlErrMsg = SDL_GetError();
+        throw sdl2::SDL2Exception{ "SDL_ConvertSurfaceFormat() failed", sdlErrMsg };
+    }
+
+    return surface;
+}
+
+int g_failures = 0;
+
+/*
+    compares 2 surfaces of the same format and size, the unused top byte of XRGB8888 / XBGR8888 is ignored.
+    prints the result and the first different pixel, an informational check doesn't count as a failure.
+*/
+void compare(const std::string& test, SDL_Surface* expected, SDL_Surface* actual, bool informational = false) {
+    uint32_t format = expected->format->format;
+    int bytes = expected->format->BytesPerPixel;
+    uint32_t mask = bytes == 3 ? 0x00ffffff : (SDL_ISPIXELFORMAT_ALPHA(format) ? 0xffffffff : 0x00ffffff);
+    long mismatches = 0;
+    char first[128] = "";
+
+    for (int y = 0; y < expected->h; ++y) {
+        const uint8_t* e = static_cast<const uint8_t*>(expected->pixels) + static_cast<size_t>(y) * expected->pitch;
+        const uint8_t* a = static_cast<const uint8_t*>(actual->pixels) + static_cast<size_t>(y) * actual->pitch;
+        for (int x = 0; x < expected->w; ++x, e += bytes, a += bytes) {
+            uint32_t ep = e[0] | (e[1] << 8) | (e[2] << 16) | (bytes == 4 ? static_cast<uint32_t>(e[3]) << 24 : 0);
+            uint32_t ap = a[0] | (a[1] << 8) | (a[2] << 16) | (bytes == 4 ? static_cast<uint32_t>(a[3]) << 24 : 0);
+            if ((ep & mask) != (ap & mask)) {
+                if (mismatches == 0) {
+                    snprintf(first, sizeof(first), ",\"first\":{\"x\":%d,\"y\":%d,\"expected\":\"%08x\",\"actual\":\"%08x\"}", x, y, ep, ap);
+                }
+
+                ++mismatches;
+            }
+        }
+    }
+
+    std::cout << "{\"test\":\"" << test << "\",\"kernels\":\"" << sdl2::get_surface_kernels().name
+              << "\",\"pixels\":" << expected->w * expected->h << ",\"mismatches\":" << mismatches << first
+              << (informational ? ",\"informational\":true}" : "}") << std::endl;
+
+    if (mismatches && !informational) {
+        ++g_failures;
+    }
+}
+
+struct Format {
+    const char* name;
+    uint32_t format;
+};
+
+void test_fill() {
+    const uint32_t COLORS[] = { 0x00000000, 0xffffffff, 0x80ff007f, 0x01fe7f80 };
+    const SDL_Rect RECTS[] = { { 0, 0, WIDTH, HEIGHT }, { 3, 5, 17, 9 }, { -4, -2, 11, 7 }, { WIDTH - 5, HEIGHT - 3, 20, 20 } };
+
+    for (uint32_t color : COLORS) {
+        sdl2::Surface expected = make_surface(SDL_PIXELFORMAT_ARGB8888, dst_pixel);
+        sdl2::Surface actual = make_surface(SDL_PIXELFORMAT_ARGB8888, dst_pixel);
+        for (const SDL_Rect& rect : RECTS) {
+            SDL_FillRect(expected.get(), &rect, color);
+            sdl2::surface_fill(actual.get(), &rect, color);
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "fill/ARGB8888/%08x", color);
+        compare(name, expected.get(), actual.get());
+    }
+}
+
+void test_blend() {
+    const Format FORMATS[] = { { "ARGB8888", SDL_PIXELFORMAT_ARGB8888 }, { "ABGR8888", SDL_PIXELFORMAT_ABGR8888 } };
+    const int OFFSETS[][2] = { { 0, 0 }, { -5, 3 }, { 9, -2 } };
+
+    for (const Format& f : FORMATS) {
+        sdl2::Surface src = make_surface(f.format, src_pixel);
+        SDL_SetSurfaceBlendMode(src.get(), SDL_BLENDMODE_BLEND);
+
+        for (const auto& offset : OFFSETS) {
+            sdl2::Surface expected = make_surface(f.format, dst_pixel);
+            sdl2::Surface actual = make_surface(f.format, dst_pixel);
+            blend_with_formula(src.get(), expected.get(), offset[0], offset[1]);
+            sdl2::surface_blend(src.get(), nullptr, actual.get(), offset[0], offset[1]);
+
+            std::string name = f.name + std::string{ "/" } + std::to_string(offset[0]) + "," + std::to_string(offset[1]);
+            compare("blend/" + name, expected.get(), actual.get());
+
+            // what the linked SDL picks, its MMX / SIMD blitters may round differently.
+            sdl2::Surface blitted = make_surface(f.format, dst_pixel);
+            SDL_Rect dstRect = { offset[0], offset[1], WIDTH, HEIGHT };
+            SDL_BlitSurface(src.get(), nullptr, blitted.get(), &dstRect);
+            compare("blend_sdl/" + name, blitted.get(), actual.get(), true);
+        }
+    }
+}
+
+void test_copy_colorkey() {
+    sdl2::Surface src = make_surface(SDL_PIXELFORMAT_ARGB8888, src_pixel);
+    SDL_SetSurfaceBlendMode(src.get(), SDL_BLENDMODE_NONE);
+
+    // keys which are in src with other alphas, so only the rgb may count.
+    const uint32_t KEYS[] = { src_pixel(0, 0) ^ 0x12000000, src_pixel(5, 7) ^ 0xff000000, src_pixel(0, PAIR_ROWS - 1) };
+
+    for (uint32_t key : KEYS) {
+        SDL_SetColorKey(src.get(), SDL_TRUE, key);
+        sdl2::Surface expected = make_surface(SDL_PIXELFORMAT_ARGB8888, dst_pixel);
+        sdl2::Surface actual = make_surface(SDL_PIXELFORMAT_ARGB8888, dst_pixel);
+        SDL_Rect dstRect = { 2, -1, WIDTH, HEIGHT };
+        SDL_BlitSurface(src.get(), nullptr, expected.get(), &dstRect);
+        sdl2::surface_copy_colorkey(src.get(), nullptr, actual.get(), 2, -1, key);
+
+        char name[64];
+        snprintf(name, sizeof(name), "colorkey/ARGB8888/%08x", key);
+        compare(name, expected.get(), actual.get());
+    }
+}
+
+void test_convert() {
+    const Format FORMATS[] = {
+        { "ARGB8888", SDL_PIXELFORMAT_ARGB8888 }, { "XRGB8888", SDL_PIXELFORMAT_XRGB8888 },
+        { "ABGR8888", SDL_PIXELFORMAT_ABGR8888 }, { "XBGR8888", SDL_PIXELFORMAT_XBGR8888 },
+        { "RGB24", SDL_PIXELFORMAT_RGB24 }, { "BGR24", SDL_PIXELFORMAT_BGR24 }
+    };
+
+    for (const Format& from : FORMATS) {
+        // the top byte of the X formats is garbage on purpose.
+        sdl2::Surface src = make_surface(from.format, src_pixel);
+
+        for (const Format& to : FORMATS) {
+            sdl2::Surface expected = convert_with_sdl(src.get(), to.format);
+            sdl2::Surface actual = make_surface(to.format, dst_pixel);
+            sdl2::surface_convert(src.get(), actual.get());
+
+            compare(std::string{ "convert/" } + from.name + "/" + to.name, expected.get(), actual.get());
+        }
+    }
+}
+
+int main(int, char*[]) {
+    try {
+        // headless, must be set before SDL_Init().
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+        sdl2::SDL2Env env{ SDL_INIT_VIDEO };
+
+        const char* LEVELS[] = { "scalar", "sse2", "avx2" };
+        for (const char* level : LEVELS) {
+            if (!sdl2::set_surface_kernels(level)) {
+                std::cout << "{\"kernels\":\"" << level << "\",\"skipped\":\"not supported by the build or the cpu\"}" << std::endl;
+                continue;
+            }
+
+            test_fill();
+            test_blend();
+            test_copy_colorkey();
+            test_convert();
+        }
+    }
+    catch(const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return g_failures ? 1 : 0;
+}
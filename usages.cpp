@@ -9,8 +9,7 @@ constexpr const char* WINDOW_TITLE = "Rect";
 constexpr uint32_t WINDOW_WIDTH = 600;
 constexpr uint32_t WINDOW_HEIGHT = 480;
 
-constexpr uint32_t FRAME_RATE = 60;
-constexpr uint32_t FRAME_MILLI_SECONDS = 1000/ FRAME_RATE;
+constexpr double FRAME_RATE = 60;
 
 constexpr uint32_t DEFAULT_FREQUENCY = 48000;
 constexpr uint32_t DEFAULT_CHANNEL_NUM = 8;
@@ -30,6 +29,17 @@ void draw_rect(sdl2::Window& window) {
     sdl2::sdl_update_window_surface(window);
 }
 
+// only the old and the new position of the rect are pushed to the window, not the whole surface.
+void draw_moving_rect(sdl2::DamageTracker& damage, int x) {
+    SDL_Rect oldRect = { x - 1, 10, 30, 30 };
+    sdl2::sdl_fill_rect(damage, &oldRect, 0xffffffff);
+
+    SDL_Rect mvRect = { x, 10, 30, 30 };
+    sdl2::sdl_fill_rect(damage, &mvRect, 0xff00ff00);
+
+    damage.present();
+}
+
 void draw_img(sdl2::Surface& img, sdl2::Window& window) {
     SDL_Surface* windowSurf = sdl2::sdl_window_get_surface(window);
     SDL_Rect rect = { 0, 0, img->w, img->h };
@@ -58,6 +68,32 @@ void draw_text(sdl2::Font& font, sdl2::Window& window) {
     sdl2::sdl_update_window_surface(window);
 }
 
+// sprite must be ARGB8888, the usual window surface is XRGB8888, with the same channel order.
+void draw_sprites_with_compositor(sdl2::Compositor& compositor, sdl2::Surface& sprite, sdl2::Window& window) {
+    compositor.begin(window);
+    compositor.fill(nullptr, 0);
+
+    for (int i = 0; i < 100; ++i) {
+        compositor.blend(sprite.get(), nullptr, (i * 37) % 800, (i * 23) % 600);
+    }
+
+    compositor.present();
+}
+
+void render_text(sdl2::Renderer& renderer, sdl2::GlyphCache& glyphCache) {
+    sdl2::sdl_set_render_draw_color(renderer, 0, 0, 0, 255);
+    sdl2::sdl_render_clear(renderer);
+
+    // glyphs are rasterized on first use only, later frames just emit quads.
+    SDL_Color color = { 255, 255, 255, 255 };
+    sdl2::SpriteBatch batch{ renderer };
+    glyphCache.draw(batch, "Hatsune Miku", 30, 30, color);
+    glyphCache.draw(batch, "Score: " + std::to_string(SDL_GetTicks()), 30, 60, color);
+
+    batch.flush();
+    sdl2::sdl_render_present(renderer);
+}
+
 void render_simple_rect(sdl2::Renderer& renderer) {
     // clear the background, with color white.
     sdl2::sdl_set_render_draw_color(renderer, 255, 255, 255, 255);
@@ -78,6 +114,29 @@ void render_simple_rect(sdl2::Renderer& renderer) {
     sdl2::sdl_render_present(renderer);
 }
 
+void render_rects_with_command_buffer(sdl2::Renderer& renderer, sdl2::CommandBuffer& commands) {
+    commands.set_draw_color(255, 255, 255, 255);
+    commands.clear();
+
+    // the overlapping rects go to different layers, so their order is kept.
+    commands.set_draw_blend_mode(SDL_BLENDMODE_BLEND);
+
+    commands.set_layer(0);
+    commands.set_draw_color(57, 197, 187, 100);
+    commands.fill_rect(SDL_Rect{ 0, 0, 100, 100 });
+
+    commands.set_layer(1);
+    commands.set_draw_color(198, 53, 63, 155);
+    commands.fill_rect(SDL_Rect{ 50, 50, 100, 100 });
+
+    commands.flush(renderer);
+    sdl2::sdl_render_present(renderer);
+
+    const sdl2::RenderCommandStats& stats = commands.get_stats();
+    std::cout << stats.commands << " commands, " << stats.drawCalls << " draw calls, "
+              << stats.stateChanges << " state changes, " << stats.stateChangesSkipped << " skipped\n";
+}
+
 void render_line(sdl2::Renderer& renderer) {
     sdl2::sdl_set_render_draw_color(renderer, 255, 255, 255, 255);
     sdl2::sdl_render_clear(renderer);
@@ -89,7 +148,25 @@ void render_line(sdl2::Renderer& renderer) {
     points.emplace_back(SDL_Point{ 200, 200 });
     points.emplace_back(SDL_Point{ 300, 400 });
 
-    sdl2::sdl_render_draw_lines(renderer, points.data(), points.size());
+    sdl2::sdl_render_draw_lines(renderer, points);
+
+    sdl2::sdl_render_present(renderer);
+}
+
+void render_many_rects(sdl2::Renderer& renderer) {
+    sdl2::sdl_set_render_draw_color(renderer, 255, 255, 255, 255);
+    sdl2::sdl_render_clear(renderer);
+
+    // one SDL call and one error check for all the rects.
+    std::vector<SDL_Rect> rects;
+    for (int y = 0; y < 48; ++y) {
+        for (int x = 0; x < 60; ++x) {
+            rects.emplace_back(SDL_Rect{ x * 10, y * 10, 8, 8 });
+        }
+    }
+
+    sdl2::sdl_set_render_draw_color(renderer, 57, 197, 187, 255);
+    sdl2::sdl_render_fill_rects(renderer, rects);
 
     sdl2::sdl_render_present(renderer);
 }
@@ -137,31 +214,215 @@ void render_bmp_with_viewport(sdl2::Renderer& renderer, sdl2::Texture& texture)
     sdl2::sdl_render_present(renderer);
 }
 
+// runs on a producer thread, e.g. std::thread{ produce_frames, std::ref(mailbox), std::ref(running) }.
+void produce_frames(sdl2::PixelMailbox& mailbox, std::atomic<bool>& running) {
+    for (uint32_t frame = 0; running; ++frame) {
+        uint8_t* pixels = mailbox.write_buffer();
+        for (int y = 0; y < mailbox.get_height(); ++y) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(pixels + y * mailbox.get_pitch());
+            for (int x = 0; x < mailbox.get_width(); ++x) {
+                row[x] = 0xff000000 | ((x + frame) & 0xff) << 16 | ((y + frame) & 0xff) << 8;
+            }
+        }
+
+        mailbox.publish();
+    }
+}
+
+// the render thread shows the latest produced frame, it never waits for the producer.
+void render_produced_frame(sdl2::Renderer& renderer, sdl2::StreamingTexture& screen, sdl2::PixelMailbox& mailbox) {
+    screen.update(mailbox);
+    sdl2::sdl_render_copy(renderer, screen.get(), nullptr, nullptr);
+    sdl2::sdl_render_present(renderer);
+}
+
+void render_atlas_sprites(sdl2::Renderer& renderer, sdl2::Atlas& atlas, const sdl2::AtlasRegion& region) {
+    sdl2::sdl_set_render_draw_color(renderer, 255, 255, 255, 255);
+    sdl2::sdl_render_clear(renderer);
+
+    // all the sprites come from one atlas page, so they are drawn with a single SDL_RenderGeometry() call.
+    sdl2::SpriteBatch batch{ renderer };
+    for (int i = 0; i < 100; ++i) {
+        SDL_FRect dstRect = { (i % 10) * 60.0f, (i / 10) * 48.0f, 48.0f, 48.0f };
+        batch.draw(atlas, region, dstRect);
+    }
+
+    // rotated and flipped sprites stay in the same batch.
+    for (int i = 0; i < 10; ++i) {
+        SDL_FRect dstRect = { i * 60.0f, 500.0f, 48.0f, 48.0f };
+        batch.draw_ex(atlas, region, dstRect, i * 36.0, nullptr, i % 2 == 0 ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL);
+    }
+
+    batch.flush();
+    sdl2::sdl_render_present(renderer);
+}
+
+// only the objects inside the camera view reach the batch.
+void render_visible_objects(sdl2::Renderer& renderer, sdl2::SpatialGrid& grid, sdl2::SpriteBatch& batch, sdl2::Texture& texture, float cameraX, float cameraY) {
+    SDL_Rect srcRect = { 0, 0, 32, 32 };
+    for (sdl2::SpatialId id : grid.query_view(renderer, cameraX, cameraY)) {
+        SDL_FRect bounds = grid.get_bounds(id);
+        bounds.x -= cameraX;
+        bounds.y -= cameraY;
+        batch.draw(texture, srcRect, bounds);
+    }
+
+    batch.flush();
+
+    sdl2::CullStats stats = grid.get_stats();
+    std::cout << "drawn " << stats.visible << ", culled " << stats.culled << "\n";
+}
+
+// the map is drawn with one copy per visible chunk, the edited tile only re-renders its chunk.
+void render_tile_map(sdl2::Renderer& renderer, sdl2::TileMap& map, int cameraX, int cameraY) {
+    map.set_tile(10, 10, 42);
+    map.draw(cameraX, cameraY);
+    sdl2::sdl_render_present(renderer);
+}
+
+// the scratch surface of a frame comes from the arena, no heap allocation for its pixels.
+void composite_scratch_frame(sdl2::FrameArena& arena, sdl2::Surface& sprite, sdl2::Window& window) {
+    arena.reset();
+
+    sdl2::Surface scratch = arena.create_surface(WINDOW_WIDTH, WINDOW_HEIGHT, SDL_PIXELFORMAT_ARGB8888);
+    sdl2::surface_fill(scratch.get(), nullptr, 0xff000000);
+    sdl2::surface_blend(sprite.get(), nullptr, scratch.get(), 100, 100);
+    sdl2::sdl_blit_surface(scratch.get(), nullptr, sdl2::sdl_window_get_surface(window), nullptr);
+    sdl2::sdl_update_window_surface(window);
+}
+
+void stream_level_assets(sdl2::Renderer& renderer, sdl2::AssetLoader& loader) {
+    // decoding runs on the worker threads, only the texture uploads run here.
+    std::vector<sdl2::TextureHandle> textures = loader.preload({ "./cat.bmp", "./dog.png", "./map.png" });
+
+    while (loader.pending() > 0) {
+        sdl2::sdl_set_render_draw_color(renderer, 0, 0, 0, 255);
+        sdl2::sdl_render_clear(renderer);
+
+        // at most 2 ms of uploads per frame, so the frame time stays flat.
+        loader.pump(renderer, 2.0);
+
+        for (auto& texture : textures) {
+            if (texture.ready()) {
+                sdl2::sdl_render_copy(renderer, texture.get(), nullptr, nullptr);
+            }
+        }
+
+        sdl2::sdl_render_present(renderer);
+    }
+}
+
+// every asset comes from the one mapped file, the pack must outlive the font.
+void load_from_pack(sdl2::AssetPack& pack) {
+    sdl2::Surface img = sdl2::img_load(pack.get("images/test.png"));
+    sdl2::MixChunk chunk = sdl2::mix_load_wav_rw(pack.get("sounds/test.ogg"));
+    sdl2::Font font{ pack.get("fonts/test.ttf"), 24 };
+}
+
+// the first launch decodes test.png, the next ones upload the cached pixels directly.
+sdl2::Texture load_cached_texture(sdl2::Renderer& renderer, sdl2::TextureDiskCache& cache) {
+    return cache.load(renderer, "./test.png");
+}
+
+// fades the current track out and next in over 2 seconds, then loops 10s - 70s of it, player.update() runs every frame.
+void crossfade_to(sdl2::MusicPlayer& player, sdl2::MixMusic& next) {
+    player.crossfade(next, 2000);
+    player.set_loop_points(10.0, 70.0);
+}
+
+// any thread can call it, the voice with the lowest priority is stolen when all of them are busy.
+void play_footsteps(sdl2::VoiceMixer& mixer, sdl2::MixChunk& footstep) {
+    for (int i = 0; i < 100; ++i) {
+        mixer.play(footstep, 0.3f, (i % 20) / 10.0f - 1.0f, 1);
+    }
+}
+
+struct EventLoopHandler : sdl2::EventHandler<EventLoopHandler> {
+    bool running = true;
+    uint64_t lastKeyTime = 0;
+
+    void on_quit(const SDL_QuitEvent&, uint64_t) {
+        running = false;
+    }
+
+    void on_key_down(const SDL_KeyboardEvent&, uint64_t inputTime) {
+        lastKeyTime = inputTime;
+    }
+};
+
+// runs on the main loop thread, so it can touch the frame counter without a lock.
+Uint32 print_frame_count(Uint32 interval, void* param) {
+    int* frameCount = static_cast<int*>(param);
+    std::cout << *frameCount << " frames in the last second\n";
+    *frameCount = 0;
+    return interval;
+}
+
 void event_loop(sdl2::Renderer& renderer) {
-    SDL_Event event;
     sdl2::Bmp bmp { "./cat.bmp" };
     sdl2::Texture bmpTexture = sdl2::sdl_create_texture_from_surface(renderer, bmp.get());
 
-    while (true) {
-        uint32_t begin = SDL_GetTicks();
+    sdl2::FramePacer pacer{ FRAME_RATE };
+    sdl2::EventDispatcher dispatcher;
+    EventLoopHandler handler;
 
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                return;
-            }
+    int frameCount = 0;
+    sdl2::TimerWheel timers;
+    timers.add(1000, print_frame_count, &frameCount);
+
+    while (true) {
+        dispatcher.poll(handler);
+        timers.update();
+        if (!handler.running) {
+            sdl2::FrameStats stats = pacer.stats();
+            std::cout << "frame time min " << stats.minMilliSeconds << " ms, avg " << stats.avgMilliSeconds
+                      << " ms, p99 " << stats.p99MilliSeconds << " ms, missed " << stats.missedDeadlines << "\n";
+            return;
         }
 
         render_bmp_with_viewport(renderer, bmpTexture);
+        ++frameCount;
 
-        uint32_t current = SDL_GetTicks();
-        uint32_t cost = current - begin;
-
-        if (FRAME_MILLI_SECONDS > cost) {
-            SDL_Delay(FRAME_MILLI_SECONDS - cost);
+        // the key press shows up with this present.
+        if (handler.lastKeyTime != 0) {
+            std::cout << "input to present " << sdl2::EventDispatcher::milliseconds_since(handler.lastKeyTime) << " ms\n";
+            handler.lastKeyTime = 0;
         }
+
+        pacer.wait();
     }
 }
 
+// the main thread polls and records, the render thread replays and presents the previous frame meanwhile.
+void threaded_event_loop(sdl2::Window& window) {
+    sdl2::RenderThread renderThread{ window, -1, SDL_RENDERER_ACCELERATED };
+
+    sdl2::Bmp bmp { "./cat.bmp" };
+    sdl2::Texture bmpTexture = renderThread.invoke([&bmp](sdl2::Renderer& renderer) {
+        return sdl2::sdl_create_texture_from_surface(renderer, bmp.get());
+    }).get();
+
+    sdl2::EventDispatcher dispatcher;
+    EventLoopHandler handler;
+
+    for (int frame = 0; handler.running; ++frame) {
+        dispatcher.poll(handler);
+
+        sdl2::CommandBuffer& commands = renderThread.begin_frame();
+        commands.set_draw_color(255, 255, 255, 255);
+        commands.clear();
+
+        SDL_Rect rect = { frame % static_cast<int>(WINDOW_WIDTH), 100, 200, 200 };
+        commands.copy(bmpTexture, nullptr, &rect);
+        renderThread.submit();
+    }
+
+    // the texture belongs to the render thread, it is destroyed there too, once the frames above are presented.
+    renderThread.invoke([&bmpTexture](sdl2::Renderer&) {
+        sdl2::Texture destroyed{ std::move(bmpTexture) };
+    }).get();
+}
+
 int main() {
     try {
         sdl2::SDL2Env env{ SDL_INIT_VIDEO | SDL_INIT_AUDIO };
@@ -171,11 +432,10 @@ int main() {
         sdl2::Window window{ WINDOW_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT, 0 };
         sdl2::Renderer renderer{ window, -1, SDL_RENDERER_ACCELERATED };
 
-        // play a sound.
+        // play the background music, streamed instead of decoded into a MixChunk.
         sdl2::MixOpenAudio moa{ DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, DEFAULT_CHANNEL_NUM, DEFAULT_CHUNK_SIZE };
-        SDL_RWops* ops = sdl2::sdl_rw_from_file("./test.ogg", "rb");
-        sdl2::MixChunk chunk = sdl2::mix_load_wav_rw(ops, 1);
-        sdl2::mix_play_channel(-1, chunk, -1);
+        sdl2::MixMusic music{ "./test.ogg" };
+        sdl2::mix_play_music(music, -1);
 
         // render picture.
         event_loop(renderer);